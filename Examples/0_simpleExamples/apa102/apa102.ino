@@ -78,6 +78,8 @@ void loop()
   updateColors(maxBrightness, 0 , 0);
   // Display the pixels on the LED strip
   strip.sendPixels(numPixels, pixels);
+  // Latch the pixels sent with the APA102 end frame
+  strip.refresh();
   // Wait 0.1 seconds
   delay(100);
 
@@ -85,6 +87,8 @@ void loop()
   updateColors(0, maxBrightness, 0);
   // Display the pixels on the LED strip
   strip.sendPixels(numPixels, pixels);
+  // Latch the pixels sent with the APA102 end frame
+  strip.refresh();
   // Wait 0.1 seconds
   delay(100);
 
@@ -92,6 +96,8 @@ void loop()
   updateColors(0, 0, maxBrightness);
   // Display the pixels on the LED strip
   strip.sendPixels(numPixels, pixels);
+  // Latch the pixels sent with the APA102 end frame
+  strip.refresh();
   // Wait 0.1 seconds
   delay(100);
 
@@ -99,6 +105,8 @@ void loop()
   updateColors( maxBrightness, maxBrightness, maxBrightness);
   // Display the pixels on the LED strip
   strip.sendPixels(numPixels, pixels);
+  // Latch the pixels sent with the APA102 end frame
+  strip.refresh();
   // Wait 0.1 seconds
   delay(100);
 
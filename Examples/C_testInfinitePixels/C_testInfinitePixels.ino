@@ -198,6 +198,61 @@ void rainbow1N(uint8_t brightness)
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pixel generator for sendGenerated(): each pixel is the next color
+/// of the rainbow. It must be fast (see generatorCycles) to meet the timing
+/// constraints of the LED strip.
+////////////////////////////////////////////////////////////////////////////////
+struct rainbowGenerator {
+	uint8_t r, g, b;
+
+	void operator()(rgb & pixel) {
+		colorWheel(1, r, g, b);
+		pixel.r = r;
+		pixel.g = g;
+		pixel.b = b;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Display numPixels with a rotating rainbow color, like rainbow1N,
+/// but letting the library call the generator and handle interrupts.
+////////////////////////////////////////////////////////////////////////////////
+void rainbowGeneratedN(uint8_t brightness)
+{
+	rainbowGenerator rainbow = {brightness, 0, 0};
+
+	for (uint16_t iter = 0; iter < 20 ; iter++) {
+		myLeds.sendGenerated<rgb>(numPixels, rainbow);
+		delay(100);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Display numPixels with a red, green, blue pattern of 3 pixels,
+/// then a blue gradient of 32 pixels and its mirror image, each sent in one
+/// pass by the library.
+////////////////////////////////////////////////////////////////////////////////
+void patternsN(uint8_t brightness)
+{
+	rgb stripes[3] = {};
+	stripes[0].r = brightness;
+	stripes[1].g = brightness;
+	stripes[2].b = brightness;
+
+	myLeds.sendRepeated(stripes, 3, numPixels);
+	delay(1000);
+
+	const uint8_t halfPixels = 32;
+	rgb gradient[halfPixels] = {};
+	for (uint8_t i = 0; i < halfPixels; i++) {
+		gradient[i].b = (uint16_t) brightness * i / halfPixels;
+	}
+
+	myLeds.sendMirrored(gradient, halfPixels);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief This method is automatically called once when the board boots.
 ////////////////////////////////////////////////////////////////////////////////
@@ -242,4 +297,8 @@ void loop()
   holdAndClear(1000,200);
   fade1N(16, 1);
   holdAndClear(1000,200);
+  rainbowGeneratedN(16);
+  holdAndClear(1000,200);
+  patternsN(16);
+  holdAndClear(1000,200);
 }
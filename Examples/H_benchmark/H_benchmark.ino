@@ -0,0 +1,347 @@
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/// Fast Adressable Bitbang LED Library
+/// Copyright (c)2015, 2016 Dan Truong
+///
+/// This example measures how many CPU cycles the FAB_LED library routines
+/// take, to compare optimizations and to check timing budgets.
+///
+/// Visual display:
+///
+/// In the IDE, open the Serial console to see the measurements printed.
+/// Each line shows the routine measured and its cost in CPU cycles.
+/// The APA-102 lines compare the library with a copy of its previous per-bit
+/// SPI loops, measured on the same board. No other reference results come
+/// with the library: to evaluate an optimization, run this example on your
+/// board before and after the change.
+///
+/// Hardware configuration:
+///
+/// This example works for a regular Arduino board connected to your PC via the
+/// USB port to the Arduino IDE. The measurements do not need LEDs, but if an
+/// APA-102 LED strip is connected to ports D6 (data) and D5 (clock), it will
+/// display the pixels sent. A WS2812B LED strip can be connected to port D4.
+///
+/// The cycles are counted with Timer1, so this example disables the PWM of
+/// pins 9 and 10, and does not work with libraries using Timer1, like Servo.
+///
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#include <FAB_LED.h>
+
+// Make the IDE compile at -O2 (fast code) instead of -Os (small size).
+#pragma GCC optimize ("-O2")
+
+apa102<D,6,D,5> spiLeds;
+ws2812b<D,4> wireLeds;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Number of pixels sent per measurement, and number of repetitions
+/// averaged.
+////////////////////////////////////////////////////////////////////////////////
+const uint16_t numPixels = 64;
+const uint16_t repeat = 32;
+
+hbgr pixels[numPixels] = {};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Cycle counter: Timer1 counts CPU cycles, and unlike micros(), it
+/// keeps counting while the library disables interrupts. Its 16-bit count
+/// wraps every 65536 cycles (4ms at 16MHz), so each call measured must be
+/// shorter, and the measurements are summed in 32 bits.
+////////////////////////////////////////////////////////////////////////////////
+uint16_t timerOverhead;
+
+void startCycleCounter(void)
+{
+	TCCR1A = 0;         // Normal mode, counting up to 0xFFFF
+	TCCR1B = _BV(CS10); // No prescaler: one count per CPU cycle
+	const uint16_t start = TCNT1;
+	timerOverhead = TCNT1 - start;
+}
+
+/// Adds the cycles the code given takes to the 32-bit total cycles.
+#define COUNT_CYCLES(cycles, ...)                                              \
+	{                                                                      \
+		const uint16_t start = TCNT1;                                  \
+		__VA_ARGS__;                                                   \
+		cycles += (uint16_t) (TCNT1 - start - timerOverhead);          \
+	}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Prints the cycles counted, per unit of work.
+////////////////////////////////////////////////////////////////////////////////
+void report(const char * name, uint32_t cycles, uint32_t units)
+{
+	Serial.print(name);
+	Serial.print(": ");
+	Serial.print(cycles / units);
+	Serial.print(" cycles\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Baseline: the SPI loops of the library before its byte unrolled
+/// core, on the pins of spiLeds. Each bit shifts the byte by a variable
+/// count and branches on it, and frames count bits in 32 bits.
+////////////////////////////////////////////////////////////////////////////////
+uint16_t baselineByteCount = 0;
+
+void baselineSendBytes(const uint16_t count, const uint8_t * array)
+{
+	for (uint16_t cnt = 0; cnt < count; ++cnt) {
+		// The header of APA102 pixels is 0b111bbbbb, b being brightness.
+		const bool isHeader = (baselineByteCount++ & 3) == 0;
+		const uint8_t val = (isHeader) ? (array[cnt] | 0xE0) : array[cnt];
+		for (int8_t b = 7; b >= 0; b--) {
+			const bool bit = (val >> b) & 0x1;
+			SET_PORT_LOW(D, 5);
+			if (bit) {
+				SET_PORT_HIGH(D, 6);
+			} else {
+				SET_PORT_LOW(D, 6);
+			}
+			SET_PORT_HIGH(D, 5);
+		}
+	}
+}
+
+void baselineSendFrame(const uint16_t count, const bool high)
+{
+	if (high) {
+		SET_PORT_HIGH(D, 6);
+	} else {
+		SET_PORT_LOW(D, 6);
+	}
+	for (uint32_t c = 0; c < 8 * count; c++) {
+		SET_PORT_LOW(D, 5);
+		SET_PORT_HIGH(D, 5);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief APA-102 SPI bit-banging: pixel bytes, and constant frames, each
+/// followed by the baseline.
+////////////////////////////////////////////////////////////////////////////////
+void benchSpi(void)
+{
+	uint32_t cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, spiLeds.sendPixels(numPixels, pixels));
+	}
+	report("apa102 sendPixels per byte", cycles, (uint32_t) repeat * numPixels * 4);
+	spiLeds.refresh();
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, baselineSendBytes(numPixels * 4,
+			(const uint8_t *) pixels));
+	}
+	report("apa102 baseline per byte", cycles, (uint32_t) repeat * numPixels * 4);
+	spiLeds.refresh();
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, spiLeds.spiSoftwareSendFrame(numPixels, false));
+	}
+	report("apa102 frame per byte", cycles, (uint32_t) repeat * numPixels);
+	spiLeds.refresh();
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, baselineSendFrame(numPixels, false));
+	}
+	report("apa102 baseline frame per byte", cycles, (uint32_t) repeat * numPixels);
+	spiLeds.refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rainbow generator for sendGenerated(): each pixel steps the color
+/// wheel of the previous one.
+////////////////////////////////////////////////////////////////////////////////
+struct rainbowGenerator {
+	uint8_t r, g, b;
+
+	void operator()(rgb & pixel) {
+		if (b == 0 && r != 0) {
+			r--;
+			g++;
+		} else if (r == 0 && g != 0) {
+			g--;
+			b++;
+		} else {
+			b--;
+			r++;
+		}
+		pixel.r = r;
+		pixel.g = g;
+		pixel.b = b;
+	}
+};
+
+rainbowGenerator rainbow = {255, 0, 0};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Cost of a pixel generator, to compare with the budget of the LED
+/// strip: past generatorCycles, a 1-wire LED strip resets between pixels.
+////////////////////////////////////////////////////////////////////////////////
+void benchGenerator(void)
+{
+	rgb pixel;
+
+	uint32_t cycles = 0;
+	for (uint16_t i = 0; i < repeat * numPixels; i++) {
+		COUNT_CYCLES(cycles, rainbow(pixel));
+	}
+	report("rainbow generator per pixel", cycles, (uint32_t) repeat * numPixels);
+
+	Serial.print("ws2812b generator budget: ");
+	Serial.print(ws2812b<D,6>::generatorCycles);
+	Serial.print(" cycles\n");
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, spiLeds.sendGenerated<rgb>(numPixels, rainbow));
+	}
+	report("apa102 sendGenerated per pixel", cycles, (uint32_t) repeat * numPixels);
+	spiLeds.refresh();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compositor: a 16-color background with two 4-color sprites, in
+/// grb, the ws2812b native order. The background is a gradient, the sprites
+/// have a transparent color 0.
+////////////////////////////////////////////////////////////////////////////////
+const uint16_t wirePixels = 16;
+uint8_t background[ARRAY_SIZE(wirePixels, 4)];
+uint8_t backgroundPalette[3 * 16];
+uint8_t sprite[ARRAY_SIZE(8, 2)] = {0xE4, 0x1B};
+uint8_t spritePalette[3 * 4] = {0,0,0, 32,0,0, 0,32,0, 0,0,32};
+grb wirePixelArray[wirePixels] = {};
+
+typedef fabCompositor<3, fabPaletteLayer<4>, fabSpriteLayer<2>,
+	fabSpriteLayer<2> > compositor;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Cost of compositing, to compare with the byte source budget of the
+/// LED strip, and time of sending composited pixels on a ws2812b compared to
+/// plain pixels: if the compositing fits, it runs while the line is low and
+/// both take the same time.
+////////////////////////////////////////////////////////////////////////////////
+void benchCompositor(void)
+{
+	volatile uint8_t sink;
+
+	uint32_t cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		fabPaletteLayer<4> sky = {background, backgroundPalette};
+		fabSpriteLayer<2> ship = {sprite, spritePalette, 2, 8, 0};
+		fabSpriteLayer<2> alien = {sprite, spritePalette, 10, 4, 0};
+		fabNoLayer none;
+		compositor layers = {sky, ship, alien, none, 0, 0};
+		layers.start();
+		COUNT_CYCLES(cycles,
+			for (uint16_t j = 0; j < 3 * wirePixels; j++) {
+				sink = layers.next();
+			});
+	}
+	// Average over the 3 bytes of a pixel, the layers being blended on the
+	// first one: the estimate below is the cost of that first byte.
+	report("compositor 3 layers per byte", cycles, (uint32_t) repeat * 3 * wirePixels);
+
+	Serial.print("compositor estimate: ");
+	Serial.print(compositor::cycles);
+	Serial.print(" cycles on the first byte of a pixel, ws2812b source budget: ");
+	Serial.print(ws2812b<D,4>::sourceCycles);
+	Serial.print(" cycles\n");
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		COUNT_CYCLES(cycles, wireLeds.sendPixels(wirePixels, wirePixelArray));
+	}
+	report("ws2812b sendPixels per pixel", cycles, (uint32_t) repeat * wirePixels);
+
+	cycles = 0;
+	for (uint16_t i = 0; i < repeat; i++) {
+		fabPaletteLayer<4> sky = {background, backgroundPalette};
+		fabSpriteLayer<2> ship = {sprite, spritePalette, 2, 8, 0};
+		fabSpriteLayer<2> alien = {sprite, spritePalette, 10, 4, 0};
+		COUNT_CYCLES(cycles, wireLeds.sendComposited(wirePixels, sky, ship, alien));
+	}
+	report("ws2812b sendComposited per pixel", cycles, (uint32_t) repeat * wirePixels);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sprites: 8x8 and 16x16 sprites of 2-bit pixels with a transparent
+/// color, drawn in a 32x32 packed matrix at positions mostly not aligned on
+/// bytes, some of them clipped. Prints the blits per second.
+////////////////////////////////////////////////////////////////////////////////
+fabMatrix<32, 32, fabPacked<2> > matrix;
+uint8_t bitmap8[ARRAY_SIZE(8 * 8, 2)];
+uint8_t bitmap16[ARRAY_SIZE(16 * 16, 2)];
+
+void reportRate(const char * name, uint32_t cycles, uint32_t units)
+{
+	Serial.print(name);
+	Serial.print(": ");
+	Serial.print((uint32_t) ((float) F_CPU * units / cycles));
+	Serial.print(" per second\n");
+}
+
+void benchSprites(void)
+{
+	const uint16_t blits = 1024;
+	fabSprite<2> sprite8 = {8, 8, bitmap8, NULL, 0, 0};
+	fabSprite<2> sprite16 = {16, 16, bitmap16, NULL, 0, 0};
+
+	uint32_t cycles = 0;
+	for (uint16_t i = 0; i < blits; i++) {
+		COUNT_CYCLES(cycles, matrix.draw(sprite8, (i % 37) - 4, (i % 29) - 4));
+	}
+	reportRate("8x8 sprite blits", cycles, blits);
+
+	cycles = 0;
+	for (uint16_t i = 0; i < blits; i++) {
+		COUNT_CYCLES(cycles, matrix.draw(sprite16, (i % 37) - 8, (i % 29) - 8));
+	}
+	reportRate("16x16 sprite blits", cycles, blits);
+}
+
+void setup()
+{
+	Serial.begin(9600);
+	startCycleCounter();
+
+	for (uint16_t i = 0; i < numPixels; i++) {
+		pixels[i].h = 1;
+		pixels[i].r = i;
+		pixels[i].g = 2 * i;
+		pixels[i].b = 255 - i;
+	}
+
+	for (uint8_t i = 0; i < 16; i++) {
+		backgroundPalette[3 * i] = i;
+		backgroundPalette[3 * i + 1] = 0;
+		backgroundPalette[3 * i + 2] = 15 - i;
+	}
+	for (uint16_t i = 0; i < wirePixels; i++) {
+		SET_PIXEL(background, i, 4, i % 16);
+	}
+
+	for (uint16_t i = 0; i < sizeof(bitmap8); i++) {
+		bitmap8[i] = 0x1B + i;
+	}
+	for (uint16_t i = 0; i < sizeof(bitmap16); i++) {
+		bitmap16[i] = 0xE4 - i;
+	}
+}
+
+void loop()
+{
+	benchSpi();
+	benchGenerator();
+	benchCompositor();
+	benchSprites();
+	Serial.print("\n");
+	delay(2000);
+}
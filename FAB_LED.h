@@ -27,17 +27,25 @@
 // so make the IDE compile at -O2 instead of -Os (size).
 #pragma GCC optimize ("-O2")
 
-// static_assert is a built-in C++ 11 assert that Arduino does not seem to support
-#ifndef static_assert
+// static_assert is a built-in C++ 11 assert, older compilers get a typedef
+// of a negative size array instead.
+#if __cplusplus >= 201103L
+#define SA2TXT2(x) # x
+#define SA2TXT(x) SA2TXT2(x)
+#define STATIC_ASSERT(X,M) static_assert(X, SA2TXT(M))
+#else
 #define STATIC_ASSERT4(COND,MSG,LIN) typedef char assert_##MSG##_##LIN[(!!(COND))*2-1]
 #define STATIC_ASSERT3(X,M,L) STATIC_ASSERT4(X, M, L)
 #define STATIC_ASSERT2(X,M,L) STATIC_ASSERT3(X,M,L)
-//#define STATIC_ASSERT(X,M)    STATIC_ASSERT2(X,M,__LINE__)
-#define STATIC_ASSERT(X,M)    
+#define STATIC_ASSERT(X,M)    STATIC_ASSERT2(X,M,__LINE__)
+#endif
+
+// Functor parameters bind temporaries and lambdas in C++ 11 with a forwarding
+// reference, older compilers take an lvalue reference.
+#if __cplusplus >= 201103L
+#define FAB_FORWARD_REF &&
 #else
-#define SA2TXT2(x) # x
-#define SA2TXT(x) SA2TXT2(x)
-#define STATIC_ASSERT(X,M) static_assert(X, SA2TXT(M))
+#define FAB_FORWARD_REF &
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,16 +62,16 @@
 //#define PT_GBR 0b10100000
 //#define PT_BRG 0b01100000
 #define PT_COL   0b11100000 // Mask for 3-byte colors
-#define PT_IS_SAME_COLOR(v1, v2) ((v1) & T_COL == (v2) & T_COL)
+#define PT_IS_SAME_COLOR(v1, v2) (((v1) & PT_COL) == ((v2) & PT_COL))
 
 // Extra pixels bytes, 0 none, 2 invalid.
 #define PT_XXXW  0b00000001 // Postfix white pixel brightness (sk6812)
 #define PT_BXXX  0b00000010 // APA 102 prefix brightness pixel 0b111bbbbb
 #define PT_XBYT  0b00000011 // Mask for extra byte(s)
-#define PT_HAS_WHITE(v)  ((v) & PT_XBYT == PT_XXXW)
-#define PT_HAS_BRIGHT(v) ((v) & PT_XBYT == PT_BXXX)
-#define PT_IS_3B(v) ((v) & PT_XVAL == 0)
-#define PT_IS_4B(v) ((v) & PT_XVAL != 0)
+#define PT_HAS_WHITE(v)  (((v) & PT_XBYT) == PT_XXXW)
+#define PT_HAS_BRIGHT(v) (((v) & PT_XBYT) == PT_BXXX)
+#define PT_IS_3B(v) (((v) & PT_XBYT) == 0)
+#define PT_IS_4B(v) (((v) & PT_XBYT) != 0)
 
 // apa102, apa106 native color order
 typedef struct rgb_t {
@@ -117,6 +125,40 @@ typedef struct hbgr_t {
 	union { uint8_t r; uint8_t red; };
 } hbgr;
 
+// 16-bit per color pixels, 8.8 fixed point, sent with temporal dithering
+typedef struct rgb48_t {
+	static const uint8_t type = PT_RGB;
+	union { uint16_t r; uint16_t red; };
+	union { uint16_t g; uint16_t green; };
+	union { uint16_t b; uint16_t blue; };
+} rgb48;
+
+typedef struct rgbw64_t {
+	static const uint8_t type = PT_RGB | PT_XXXW;
+	union { uint16_t r; uint16_t red; };
+	union { uint16_t g; uint16_t green; };
+	union { uint16_t b; uint16_t blue; };
+	union { uint16_t w; uint16_t white; };
+} rgbw64;
+
+// 16-bit packed pixels, 0bRRRRRGGGGGGBBBBB, 64K colors
+typedef struct rgb565_t {
+	static const uint8_t type = PT_RGB;
+	uint16_t value;
+} rgb565;
+
+// 16-bit packed pixels, 0bxRRRRRGGGGGBBBBB, 32K colors
+typedef struct rgb555_t {
+	static const uint8_t type = PT_RGB;
+	uint16_t value;
+} rgb555;
+
+// 16-bit packed pixels, 0bRRRRGGGGBBBBWWWW, 4K colors and 16 whites
+typedef struct rgbw4444_t {
+	static const uint8_t type = PT_RGB | PT_XXXW;
+	uint16_t value;
+} rgbw4444;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Helper macro for palette index encoding into a char * array when
@@ -161,6 +203,10 @@ typedef struct hbgr_t {
 #define CYCLES(time_ns)     (((CYCLES_PER_SEC * (time_ns)) + NS_PER_SEC - 1ULL) / NS_PER_SEC)
 #define NANOSECONDS(cycles) (((cycles) * NS_PER_SEC + CYCLES_PER_SEC-1) / CYCLES_PER_SEC)
 
+/// @brief Longest low level time between two bits that 1-wire LED strips
+/// accept without a reset. This bounds the work done between bytes.
+#define FAB_MAX_LOW_NS      5000
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief definitions for class template specializations
@@ -190,6 +236,13 @@ enum pixelFormat {
 };
 #define IS_PIXEL_FORMAT_3B(color) (color < RGBW)
 #define IS_PIXEL_FORMAT_4B(color) (color >= RGBW)
+/// Pixel type of a pixel format, PT_RGB for NONE
+#define PIXEL_FORMAT_TYPE(color) (                                             \
+	((color) == GRB)  ? PT_GRB :                                           \
+	((color) == BGR)  ? PT_BGR :                                           \
+	((color) == RGBW) ? (PT_RGB | PT_XXXW) :                               \
+	((color) == GRBW) ? (PT_GRB | PT_XXXW) :                               \
+	((color) == HBGR) ? (PT_BGR | PT_BXXX) : PT_RGB)
 
 /// @brief Type of low-level method to send data for the LED strip (see sendBytes)
 enum ledProtocol {
@@ -201,9 +254,11 @@ enum ledProtocol {
 	ONE_PORT_UART = 6,      // Not implemented
 
 	SPI_BITBANG = 7,        // APA-102 and any LED with data and clock line
-	SPI_HARDWARE = 8        // Not implemented
+	SPI_HARDWARE = 8,       // Not implemented
+	SPI_PARALLEL_BITBANG = 9 // Same, with up to 7 data lines sharing one clock line
 };
 #define PROTOCOL_SPI SPI_BITBANG
+#define IS_PROTOCOL_SPI(p) ((p) == SPI_BITBANG || (p) == SPI_PARALLEL_BITBANG)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,6 +335,9 @@ enum ledProtocol {
 // Note: gcc converts these bit manipulations to sbi and cbi instructions
 #define SET_PORT_HIGH(portId, portPin) AVR_PORT(portId) |= 1U << portPin
 #define SET_PORT_LOW( portId, portPin) AVR_PORT(portId) &= ~(1U << portPin);
+// Set high or keep several pins of a port in one write
+#define FAB_PORT_OR( portId, mask) AVR_PORT(portId) |= (mask)
+#define FAB_PORT_AND(portId, mask) AVR_PORT(portId) &= (mask)
 
 /// Method to optimally delay N cycles with nops for bitBang.
 #define DELAY_CYCLES(count) if (count > 0) __builtin_avr_delay_cycles(count);
@@ -287,10 +345,16 @@ enum ledProtocol {
 // Number of cycles sbi and cbi instructions take when using SET macros
 const int sbiCycles = 2;
 const int cbiCycles = 2;
+// Number of cycles in, or/and and out instructions take when using FAB_PORT_OR/AND
+const int portCycles = 3;
 
 #define DISABLE_INTERRUPTS {uint8_t oldSREG = SREG; __builtin_avr_cli()
 #define RESTORE_INTERRUPTS SREG = oldSREG; }
 
+/// Read a constant byte or word stored in flash memory with PROGMEM
+#define FAB_PGM_BYTE(addr) pgm_read_byte(addr)
+#define FAB_PGM_WORD(addr) pgm_read_word(addr)
+
 
 ////////////////////////////////////////////////////////////////////////////////
 #elif defined(__arm__)
@@ -310,6 +374,8 @@ const int cbiCycles = 2;
 #define SET_DDR_HIGH( portId, portPin)
 #define FAB_DDR( portId, val)
 #define FAB_PORT(portId, val)
+#define FAB_PORT_OR( portId, mask)
+#define FAB_PORT_AND(portId, mask)
 
 #define SET_PORT_HIGH(portId, pinId)   digitalWriteFast(pinId, 1)
 #define SET_PORT_LOW( portId, pinId)   digitalWriteFast(pinId, 0)
@@ -320,10 +386,15 @@ const int cbiCycles = 2;
 // Number of cycles sbi and cbi instructions take
 const int sbiCycles = 2;
 const int cbiCycles = 2;
+const int portCycles = 3;
 
 #define DISABLE_INTERRUPTS {uint8_t oldSREG = SREG; cli()
 #define RESTORE_INTERRUPTS SREG = oldSREG; }
 
+/// Flash memory is directly addressable
+#define FAB_PGM_BYTE(addr) (*(const uint8_t *)(addr))
+#define FAB_PGM_WORD(addr) (*(const uint16_t *)(addr))
+
 //mov r0, #COUNT
 //L:
 //subs r0, r0, #1
@@ -355,1507 +426,5346 @@ const int cbiCycles = 2;
 
 
 
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+
 ////////////////////////////////////////////////////////////////////////////////
-// Base class defining LED strip operations allowed.
+/// @brief Expansion tables of 4, 5 and 6-bit colors to 8-bit colors, stored
+/// in flash. Row 0 scales linearly (bit replication so that the maximum
+/// value maps to 255), row 1 also applies a 2.2 gamma correction.
 ////////////////////////////////////////////////////////////////////////////////
-static const uint8_t blank[3] = {128,128,128};
+static const uint8_t fabExpand4[2][16] PROGMEM = {
+	{
+		  0,  17,  34,  51,  68,  85, 102, 119, 136, 153, 170, 187, 204, 221, 238, 255
+	}, {
+		  0,   1,   3,   7,  14,  23,  34,  48,  64,  83, 105, 129, 156, 186, 219, 255
+	}
+};
 
-#define FAB_TDEF int16_t high1,             \
-		int16_t low1,               \
-		int16_t high0,              \
-		int16_t low0,               \
-		uint32_t minMsRefresh,      \
-		avrLedStripPort dataPortId, \
-		uint8_t dataPortPin,        \
-		avrLedStripPort clockPortId,\
-		uint8_t clockPortPin,       \
-		pixelFormat colors,         \
-		ledProtocol protocol
+static const uint8_t fabExpand5[2][32] PROGMEM = {
+	{
+		  0,   8,  16,  24,  33,  41,  49,  57,  66,  74,  82,  90,  99, 107, 115, 123,
+		132, 140, 148, 156, 165, 173, 181, 189, 198, 206, 214, 222, 231, 239, 247, 255
+	}, {
+		  0,   0,   1,   1,   3,   5,   7,  10,  13,  17,  21,  26,  32,  38,  44,  52,
+		 60,  68,  77,  87,  97, 108, 120, 132, 145, 159, 173, 188, 204, 220, 237, 255
+	}
+};
 
-#define FAB_TVAR high1, low1, high0, low0, minMsRefresh, dataPortId, dataPortPin, clockPortId, clockPortPin, colors, protocol
+static const uint8_t fabExpand6[2][64] PROGMEM = {
+	{
+		  0,   4,   8,  12,  16,  20,  24,  28,  32,  36,  40,  44,  48,  52,  56,  60,
+		 65,  69,  73,  77,  81,  85,  89,  93,  97, 101, 105, 109, 113, 117, 121, 125,
+		130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
+		195, 199, 203, 207, 211, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255
+	}, {
+		  0,   0,   0,   0,   1,   1,   1,   2,   3,   4,   4,   5,   7,   8,   9,  11,
+		 13,  14,  16,  18,  20,  23,  25,  28,  31,  33,  36,  40,  43,  46,  50,  54,
+		 57,  61,  66,  70,  74,  79,  84,  89,  94,  99, 105, 110, 116, 122, 128, 134,
+		140, 147, 153, 160, 167, 174, 182, 189, 197, 205, 213, 221, 229, 238, 246, 255
+	}
+};
 
-/// @brief Class to drive LED strips. Relies on custom sendBytes() method to push data to LEDs
-//template<
-//	int16_t high1,          // Number of cycles high for logical one
-//	int16_t low1,           // Number of cycles  low for logical one
-//	int16_t high0,          // Number of cycles high for logical zero
-//	int16_t low0,           // Number of cycles  low for logical zero
-//	uint32_t minMsRefresh,  // Minimum milliseconds to wait to reset LED strip data stream
-//	avrLedStripPort dataPortId, // AVR port the LED strip is attached to
-//	uint8_t dataPortPin         // AVR port bit the LED strip is attached to
-//>
-template <FAB_TDEF>
-class avrBitbangLedStrip
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Temporal dithering of 8.8 fixed point colors to 8 bits.
+/// The color is rounded up when its 8-bit fraction plus the threshold carries.
+/// Over 256 frames, where the threshold takes every value once, the average
+/// output is exactly value/256. The cost is constant and branch free.
+/// These routines are plain C so they can be validated on a host computer.
+////////////////////////////////////////////////////////////////////////////////
+static inline uint8_t fabDither(const uint16_t value, const uint8_t threshold)
 {
-	static const uint8_t bytesPerPixel = IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
+	const uint8_t high = value >> 8;
+	const uint8_t low = value;
+	const uint8_t sum = low + threshold;
+	// Carry out of the fraction, except when the color is already maximal
+	return high + ((sum < low) & (high != 255));
+}
 
-	public:
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Constructor: Set selected dataPortId.dataPortPin to digital output
+/// @brief Dithering threshold of a frame: the bit-reversed frame counter
+/// spreads consecutive thresholds evenly to minimize visible flicker.
+static inline uint8_t fabDitherThreshold(const uint8_t frame)
+{
+	uint8_t t = frame;
+	t = (t & 0xF0) >> 4 | (t & 0x0F) << 4;
+	t = (t & 0xCC) >> 2 | (t & 0x33) << 2;
+	t = (t & 0xAA) >> 1 | (t & 0x55) << 1;
+	return t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief High dynamic range output for APA102 LEDs, which have a 5-bit
+/// current level (header) on top of their 8-bit PWM colors.
+/// A 16-bit color c is displayed as level/31 * pwm/255 = c/65535. The lowest
+/// level that fits the brightest color of the pixel is picked, which maximizes
+/// the PWM precision of dim pixels. These routines are plain C so they can be
+/// validated on a host computer.
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief 2^18 * 31 / (257 * level), to scale a 16-bit color to the PWM value
+/// of a current level without a division.
+static const uint16_t fabHdrScale[32] PROGMEM = {
+	    0, 31620, 15810, 10540,  7905,  6324,  5270,  4517,
+	 3953,  3513,  3162,  2875,  2635,  2432,  2259,  2108,
+	 1976,  1860,  1757,  1664,  1581,  1506,  1437,  1375,
+	 1318,  1265,  1216,  1171,  1129,  1090,  1054,  1020
+};
+
+/// @brief Returns the lowest current level [1..31] able to display a color.
+static inline uint8_t fabHdrLevel(const uint16_t maxColor)
+{
+	const uint8_t level = (((uint32_t) maxColor * 31) >> 16) + 1;
+	return (level > 31) ? 31 : level;
+}
+
+/// @brief Returns the 8-bit PWM value of a 16-bit color at a current level.
+static inline uint8_t fabHdrColor(const uint16_t color, const uint8_t level)
+{
+	const uint32_t pwm = ((uint32_t) color *
+		FAB_PGM_WORD(&fabHdrScale[level]) + (1UL << 17)) >> 18;
+	return (pwm > 255) ? 255 : pwm;
+}
+
+/// @brief Threshold increment between two consecutive pixels of a frame,
+/// 256 divided by the golden ratio, to decorrelate neighboring pixels.
+/// It is odd, so 256 consecutive pixels take every threshold once.
+#define FAB_DITHER_PIXEL_STEP 0x9F
+
+#ifdef FAB_GAMMA
+////////////////////////////////////////////////////////////////////////////////
+/// @brief 8-bit 2.2 gamma correction table stored in flash, applied to every
+/// byte sent when FAB_GAMMA is defined before including FAB_LED.h
+////////////////////////////////////////////////////////////////////////////////
+static const uint8_t fabGamma8[256] PROGMEM = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+	  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+	  3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+	  6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+	 12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+	 20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+	 30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+	 42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+	 56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+	 73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+	 91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+	113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+	137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+	163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+	192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+	223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+#endif // FAB_GAMMA
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Gamma correction and global brightness applied to every byte sent
+/// to the LEDs, shared by the LED strip classes. Compiles to nothing unless
+/// FAB_GAMMA or FAB_BRIGHTNESS are defined before including FAB_LED.h.
+/// The strip parameter is the LED strip class, so each gets its own
+/// brightness.
+////////////////////////////////////////////////////////////////////////////////
+template <class strip>
+struct fabByteFilter {
+#ifdef FAB_BRIGHTNESS
 	////////////////////////////////////////////////////////////////////////
-	avrBitbangLedStrip();
+	/// @brief Global brightness of the LED strip [0..255], applied to every
+	/// byte sent when FAB_BRIGHTNESS is defined before including FAB_LED.h
 	////////////////////////////////////////////////////////////////////////
-	~avrBitbangLedStrip() { };
+	static uint8_t brightness;
+
+	static inline void setBrightness(const uint8_t value) {
+		brightness = value;
+	}
+#endif
 
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Prints to console the configuration
-	/// @note You must implement the print routines (see example)
+	/// @brief Estimated CPU cost of filterByte(), which delays the next byte
 	////////////////////////////////////////////////////////////////////////
-	template <void printChar(const char *),void printInt(uint32_t)>
-#ifndef DISABLE_DEBUG_METHOD
-	static inline void debug(void);
+	static const uint8_t filterCycles =
+#ifdef FAB_GAMMA
+		5 +
 #endif
+#ifdef FAB_BRIGHTNESS
+		6 +
+#endif
+		0;
 
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends N bytes to the LED using bit-banging.
-	///
-	/// @param[in] count Number of bytes sent
-	/// @param[in] array Array of bytes to send
-	///
-	/// @warning
-	/// The caller must handle interupts!
-	/// If interupts are not off, the timer interupt will happen, and it takes
-	/// too long and will cause a LED strip reset.
-	///
-	/// @note
-	/// __attribute__ ((always_inline)) forces gcc to inline this function in
-	/// the caller, to optimize there and avoid function call overhead. The
-	/// timing is critical at 16MHz.
-	/// @note
-	/// __builtin_avr_delay_cycles() is a gcc built-in that will generate ASM
-	/// to implement the exact number of cycle delays specified using the most
-	/// compact instruction loop, and is portable.
-	/// @note
-	/// The AVR port bit-set math will be changed by gcc to a sbi/cbi in ASM
+	/// @brief Applies gamma correction and brightness to a byte sent to the
+	/// LEDs
 	////////////////////////////////////////////////////////////////////////
-	static inline void
-	sendBytes(const uint16_t count, const uint8_t * array)
-	__attribute__ ((always_inline));
+	static inline uint8_t filterByte(const uint8_t value)
+	__attribute__ ((always_inline))
+	{
+		uint8_t val = value;
+#ifdef FAB_GAMMA
+		val = FAB_PGM_BYTE(&fabGamma8[val]);
+#endif
+#ifdef FAB_BRIGHTNESS
+		// Scale by (brightness+1)/256 with one 8x8 multiply, 255 is a no-op.
+		val = ((uint16_t) val * brightness + val) >> 8;
+#endif
+		return val;
+	}
+};
+
+#ifdef FAB_BRIGHTNESS
+template <class strip>
+uint8_t fabByteFilter<strip>::brightness = 255;
+#endif
+
+/// @brief Expands a color of 4, 5 or 6 bits to 8 bits, with optional gamma
+template <uint8_t bits, bool gamma>
+static inline uint8_t fabExpand(const uint8_t value)
+{
+	return (bits == 4) ? FAB_PGM_BYTE(&fabExpand4[gamma][value]) :
+		(bits == 5) ? FAB_PGM_BYTE(&fabExpand5[gamma][value]) :
+		FAB_PGM_BYTE(&fabExpand6[gamma][value]);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lanes of multi-lane LED strips, up to 8 LED strips driven in
+/// parallel from any mix of port pins. fabLane<D,6> is a LED strip data line
+/// on port D pin 6, fabNoLane an unused lane. Used lanes come first.
+////////////////////////////////////////////////////////////////////////////////
+template<avrLedStripPort portId, uint8_t portPin>
+struct fabLane {
+	static const bool used = true;
+	static const avrLedStripPort port = portId;
+	static const uint8_t pin = portPin;
+};
+
+struct fabNoLane {
+	static const bool used = false;
+	static const avrLedStripPort port = A;
+	static const uint8_t pin = 0;
+};
+
+/// @brief Layout of the pixel array of multi-lane LED strips
+enum laneLayout {
+	LANES_SPLIT = 0,      // The array is split in one block of pixels per lane
+	LANES_INTERLEAVED = 1 // The pixels of the array go to each lane in turn
+};
+
+#define FAB_LANES_TDEF class L0, class L1, class L2, class L3, \
+		class L4, class L5, class L6, class L7
+#define FAB_LANES_TVAR L0, L1, L2, L3, L4, L5, L6, L7
+
+/// Pin mask of a lane if it is on the port, else zero
+#define FAB_LANE_MASK(L, portId) \
+	((L::used && L::port == portId) ? (1U << L::pin) : 0U)
+/// Pin mask of a lane if it is on the port and sends a zero, else zero
+#define FAB_LANE_ZERO(L, v, portId) \
+	(((v) & 0x80) ? 0U : FAB_LANE_MASK(L, portId))
+/// Pin mask of a lane if it is on the port and has pixels left, else zero
+#define FAB_LANE_ON(L, lane, portId) \
+	((active & (1 << lane)) ? FAB_LANE_MASK(L, portId) : 0U)
+
+/// Pin mask of all the lanes of a port
+#define FAB_LANES_MASK(portId) ((uint8_t) ( \
+	FAB_LANE_MASK(L0, portId) | FAB_LANE_MASK(L1, portId) | \
+	FAB_LANE_MASK(L2, portId) | FAB_LANE_MASK(L3, portId) | \
+	FAB_LANE_MASK(L4, portId) | FAB_LANE_MASK(L5, portId) | \
+	FAB_LANE_MASK(L6, portId) | FAB_LANE_MASK(L7, portId)))
+/// Pin mask of the lanes of a port sending a zero, MSB of bytes v0..v7
+#define FAB_LANES_ZERO(portId) ((uint8_t) ( \
+	FAB_LANE_ZERO(L0, v0, portId) | FAB_LANE_ZERO(L1, v1, portId) | \
+	FAB_LANE_ZERO(L2, v2, portId) | FAB_LANE_ZERO(L3, v3, portId) | \
+	FAB_LANE_ZERO(L4, v4, portId) | FAB_LANE_ZERO(L5, v5, portId) | \
+	FAB_LANE_ZERO(L6, v6, portId) | FAB_LANE_ZERO(L7, v7, portId)))
+/// Pin mask of the lanes of a port having pixels left
+#define FAB_LANES_ON(portId) ((uint8_t) ( \
+	FAB_LANE_ON(L0, 0, portId) | FAB_LANE_ON(L1, 1, portId) | \
+	FAB_LANE_ON(L2, 2, portId) | FAB_LANE_ON(L3, 3, portId) | \
+	FAB_LANE_ON(L4, 4, portId) | FAB_LANE_ON(L5, 5, portId) | \
+	FAB_LANE_ON(L6, 6, portId) | FAB_LANE_ON(L7, 7, portId)))
+
+/// Statements applied to every port, compiled out for ports without lanes
+#define FAB_LANES_PORTS(op) op(A) op(B) op(C) op(D) op(E) op(F)
+#define FAB_LANES_COUNT(portId) + (FAB_LANES_MASK(portId) ? 1 : 0)
+#define FAB_LANES_KEEP(portId) \
+	if (FAB_LANES_MASK(portId)) keep[portId] = ~FAB_LANES_ZERO(portId);
+#define FAB_LANES_SET_ON(portId) \
+	if (FAB_LANES_MASK(portId)) on[portId] = FAB_LANES_ON(portId);
+#define FAB_LANES_HIGH(portId) \
+	if (FAB_LANES_MASK(portId)) FAB_PORT_OR(portId, on[portId]);
+#define FAB_LANES_LOW_ZEROS(portId) \
+	if (FAB_LANES_MASK(portId)) FAB_PORT_AND(portId, keep[portId]);
+#define FAB_LANES_LOW(portId) \
+	if (FAB_LANES_MASK(portId)) FAB_PORT_AND(portId, (uint8_t) ~FAB_LANES_MASK(portId));
+/// Filtered byte k of the pixel of a lane
+#define FAB_LANE_BYTE(lane) filter::filterByte(p[offset[lane]])
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sends bytes to multi-lane LED strips with the 1-wire protocol.
+/// The byte of every lane is loaded once per byte, before its first bit.
+/// Each bit then raises the lanes having pixels left, lowers the lanes sending a zero
+/// after high0 cycles, and lowers all the lanes after high1 cycles. The
+/// lanes of a port change together with one port write, so a bit costs 3
+/// writes per port used, whatever the number of lanes.
+/// The bytes go through filter::filterByte(), the gamma and brightness
+/// filter of the LED strip class, see fabByteFilter.
+///
+/// @warning The caller must handle interupts!
+////////////////////////////////////////////////////////////////////////////////
+template<int16_t high1, int16_t low1, int16_t high0, uint8_t bytesPerPixel,
+	laneLayout layout, class filter, FAB_LANES_TDEF>
+class fabLaneEncoder
+{
+	public:
+	static const uint8_t numLanes = L0::used + L1::used + L2::used +
+		L3::used + L4::used + L5::used + L6::used + L7::used;
+	static const uint8_t numPorts = 0 FAB_LANES_PORTS(FAB_LANES_COUNT);
 
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends N uint32_t in a row set to zero or 0xFFFFFFFF, to build
-	/// a frame for each pixel, and for a whole strip, SPI protocol only
+	/// @brief Estimated cycles per lane added to the low time after the last
+	/// bit of a pixel: testing if the lane has pixels left (3), loading its
+	/// next byte (6) and filtering it. Like sourceCycles for the 1-port
+	/// protocol, the lanes must fit the FAB_MAX_LOW_NS budget.
 	////////////////////////////////////////////////////////////////////////
-	static inline void
-	spiSoftwareSendFrame(const uint16_t count, bool high)
-	__attribute__ ((always_inline));
+	static const int16_t laneCycles = 3 + 6 + filter::filterCycles;
 
 	////////////////////////////////////////////////////////////////////////
-	/// @bried Implements sendBytes for the 1-port SPI protocol
+	/// @brief Sets the pins of the lanes to digital output, low
 	////////////////////////////////////////////////////////////////////////
-	static inline void
-	spiSoftwareSendBytes(const uint16_t count, const uint8_t * array)
-	__attribute__ ((always_inline));
+	static inline void init()
+	{
+		if (L0::used) SET_DDR_HIGH(L0::port, L0::pin);
+		if (L1::used) SET_DDR_HIGH(L1::port, L1::pin);
+		if (L2::used) SET_DDR_HIGH(L2::port, L2::pin);
+		if (L3::used) SET_DDR_HIGH(L3::port, L3::pin);
+		if (L4::used) SET_DDR_HIGH(L4::port, L4::pin);
+		if (L5::used) SET_DDR_HIGH(L5::port, L5::pin);
+		if (L6::used) SET_DDR_HIGH(L6::port, L6::pin);
+		if (L7::used) SET_DDR_HIGH(L7::port, L7::pin);
+		FAB_LANES_PORTS(FAB_LANES_LOW)
+	}
 
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Implements sendBytes for the 1-ports protocol
+	/// @brief Sends count bytes, numLanes times the bytes of one LED strip.
+	/// When the pixels do not divide evenly, the first lanes get one more
+	/// pixel, for example 5 pixels split on 2 lanes send 3 then 2 pixels.
 	////////////////////////////////////////////////////////////////////////
+	template <class indexType>
 	static inline void
-	onePortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
-	__attribute__ ((always_inline));
+	sendBytes(const indexType count, const uint8_t * array)
+	{
+		const indexType numPixels = count / bytesPerPixel;
+		const indexType lanePixels = numPixels / numLanes;
+		const uint8_t extraPixels = numPixels % numLanes;
+		indexType counts[8];
+		for (uint8_t lane = 0; lane < numLanes; lane++) {
+			counts[lane] = (lane < extraPixels) ? lanePixels + 1 : lanePixels;
+		}
+
+		sendLanes(counts, array);
+	}
 
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Implements sendBytes for the 2-ports protocol
+	/// @brief Sends a block of pixels of its own length to each lane, for
+	/// LED strips of different lengths. Lanes out of pixels idle low while
+	/// the others finish. Split layout only.
+	/// @param[in] counts Number of pixels of each lane
+	/// @param[in] array  Array of the pixel blocks of all lanes in a row
 	////////////////////////////////////////////////////////////////////////
+	template <class indexType>
 	static inline void
-	twoPortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
-	__attribute__ ((always_inline));
+	sendSegments(const indexType * counts, const uint8_t * array)
+	{
+		STATIC_ASSERT(layout == LANES_SPLIT, Segments_need_a_split_layout);
+		sendLanes(counts, array);
+	}
 
+	private:
 	////////////////////////////////////////////////////////////////////////
-	/// @brief Implements sendBytes for the 8-ports protocol
+	/// @brief Sends counts[lane] pixels to each lane.
+	/// Lanes having pixels left are computed once per pixel, and the byte
+	/// of every lane is loaded once per byte, out of the timed window.
 	////////////////////////////////////////////////////////////////////////
+	template <class indexType>
 	static inline void
-	eightPortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
-	__attribute__ ((always_inline));
+	sendLanes(const indexType * counts, const uint8_t * array)
+	{
+		STATIC_ASSERT(numLanes >= 1 && L0::used, Lanes_must_start_at_L0);
+		STATIC_ASSERT(low1 + numLanes * laneCycles <=
+			(int16_t) CYCLES(FAB_MAX_LOW_NS),
+			Lanes_exceed_low_time_use_fewer_lanes_or_no_FAB_GAMMA_FAB_BRIGHTNESS);
+
+		// Offset in the array of the first pixel of each lane, and
+		// distance between two pixels of a lane
+		indexType offset[8];
+		indexType maxPixels = 0;
+		for (uint8_t lane = 0; lane < numLanes; lane++) {
+			if (layout == LANES_SPLIT) {
+				offset[lane] = (lane == 0) ? 0 :
+					offset[lane - 1] + counts[lane - 1] * bytesPerPixel;
+			} else {
+				offset[lane] = lane * bytesPerPixel;
+			}
+			if (counts[lane] > maxPixels) maxPixels = counts[lane];
+		}
+		const indexType pixelStride = (layout == LANES_SPLIT) ?
+			bytesPerPixel : numLanes * bytesPerPixel;
+
+		for (indexType pix = 0; pix < maxPixels; pix++) {
+			// Lanes having pixels left, and their pins per port
+			uint8_t active = 0;
+			for (uint8_t lane = 0; lane < numLanes; lane++) {
+				if (pix < counts[lane]) active |= 1 << lane;
+			}
+			uint8_t on[F + 1];
+			FAB_LANES_PORTS(FAB_LANES_SET_ON)
+
+			for (uint8_t k = 0; k < bytesPerPixel; k++) {
+				// Load the byte of every lane, out of the timed window
+				const uint8_t * p = array + k;
+				uint8_t v0 = (active &   1) ? FAB_LANE_BYTE(0) : 0;
+				uint8_t v1 = (L1::used && (active &   2)) ? FAB_LANE_BYTE(1) : 0;
+				uint8_t v2 = (L2::used && (active &   4)) ? FAB_LANE_BYTE(2) : 0;
+				uint8_t v3 = (L3::used && (active &   8)) ? FAB_LANE_BYTE(3) : 0;
+				uint8_t v4 = (L4::used && (active &  16)) ? FAB_LANE_BYTE(4) : 0;
+				uint8_t v5 = (L5::used && (active &  32)) ? FAB_LANE_BYTE(5) : 0;
+				uint8_t v6 = (L6::used && (active &  64)) ? FAB_LANE_BYTE(6) : 0;
+				uint8_t v7 = (L7::used && (active & 128)) ? FAB_LANE_BYTE(7) : 0;
+
+				for (int8_t bit = 7; bit >= 0; bit--) {
+					// Pins kept high after high0, per port
+					uint8_t keep[F + 1];
+					FAB_LANES_PORTS(FAB_LANES_KEEP)
+
+					FAB_LANES_PORTS(FAB_LANES_HIGH)
+					DELAY_CYCLES(high0 - numPorts * portCycles);
+					FAB_LANES_PORTS(FAB_LANES_LOW_ZEROS)
+					DELAY_CYCLES(high1 - high0 - numPorts * portCycles);
+					FAB_LANES_PORTS(FAB_LANES_LOW)
+
+					v0 <<= 1; v1 <<= 1; v2 <<= 1; v3 <<= 1;
+					v4 <<= 1; v5 <<= 1; v6 <<= 1; v7 <<= 1;
+					// Shifting and testing the bits of each lane costs
+					// about 3 cycles
+					DELAY_CYCLES(low1 - numPorts * portCycles - 3 * numLanes);
+				}
+			}
+			array += pixelStride;
+		}
+	}
+};
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Clears the LED strip
-	/// @param[in] numPixels  Number of pixels to erase
-	////////////////////////////////////////////////////////////////////////
-	static inline void clear( const uint16_t numPixels)
-	__attribute__ ((always_inline));
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Sets the LED strip to a grey value
-	/// @param[in] numPixels  Number of pixels to erase
-	/// @param[in] value      Brightness of the grey [0..255]
-	////////////////////////////////////////////////////////////////////////
-	static inline void grey(
-			const uint16_t numPixels,
-			const uint8_t value)
-	__attribute__ ((always_inline));
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Byte sources produce the bytes sent to the LEDs one at a time, see
+/// sendSource(). A byte source has a next() method returning the next byte
+/// in the LED strip native order, and the constant cycles, the estimated CPU
+/// cost of next(). The 1-wire protocol computes the next byte while the data
+/// line is low after the first bit of the current byte, so a conversion
+/// fitting in that low time costs no extra time on the wire.
+///
+/// The cycles constants are hand estimates of the AVR code, not measured
+/// from an avr-gcc listing: the sourceCycles assert only rejects sources
+/// estimated over the low time budget. Measure a source with H_benchmark.
+////////////////////////////////////////////////////////////////////////////////
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends an array of 32bit words encoding 0x00bbrrgg to the LEDs
-	/// This is the standard encoding for most libraries and wastes 25% of
-	/// the SRAM.
-	///
-	/// @param[in] numPixels Number of pixels to write
-	/// @param[in] array     Array of 1 word per pixels in native order
-	///                      (most significant byte is ignored)
-	////////////////////////////////////////////////////////////////////////
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const uint32_t * pixelArray)
-	__attribute__ ((always_inline));
+/// @brief Byte source reading an array of bytes
+struct fabArraySource {
+	static const uint8_t cycles = 2;
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends 3-byte pixels to the LED strip.
-	/// This function should be the most common used method.
-	///
-	/// @note for SK6812, which uses 4 bytes per pixels, this method will send
-	/// 4 bytes per pixel and expect an array containing 4 bytes per pixel.
-	/// @param[in] numPixels Number of pixels to write
-	/// @param[in] array     Array of 3-bytes per pixels in native order
-	///                      (for example GBR for WS2812B LED strips)
-	////////////////////////////////////////////////////////////////////////
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const uint8_t * array) __attribute__ ((always_inline));
+	const uint8_t * array;
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const rgbw * array) __attribute__ ((always_inline));
+	inline uint8_t next() {
+		return *array++;
+	}
+};
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const grbw * array) __attribute__ ((always_inline));
+/// @brief Byte source reading an array of bytes stored in flash memory with
+/// PROGMEM. The flash read runs in the pipelined low time like any other
+/// byte source.
+struct fabFlashSource {
+	static const uint8_t cycles = 3;
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const hbgr * array) __attribute__ ((always_inline));
+	const uint8_t * array;
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const rgb * array) __attribute__ ((always_inline));
+	inline uint8_t next() {
+		return FAB_PGM_BYTE(array++);
+	}
+};
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const grb * array) __attribute__ ((always_inline));
+/// @brief Byte source reading 3 or 4-byte typed pixels stored in flash
+/// memory, reordered to the LED strip native order. offsets holds the
+/// offset in the pixel of each native byte, or 0xFF to send noByte.
+template <uint8_t bytesPerPixel>
+struct fabFlashPixelSource {
+	static const uint8_t cycles = 10;
+
+	const uint8_t * array;
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t stride;  // Size of a pixel in flash
+	uint8_t byte;    // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ?
+			noByte : FAB_PGM_BYTE(&array[offset]);
+		if (++byte == bytesPerPixel) {
+			byte = 0;
+			array += stride;
+		}
+		return value;
+	}
+};
 
-	static inline void sendPixels(
-			const uint16_t numPixels,
-			const bgr * array) __attribute__ ((always_inline));
+/// @brief Byte source walking an array of 3 or 4-byte pixels in RAM by step
+/// bytes per pixel, reordered to the LED strip native order like
+/// fabFlashPixelSource. When the walk reaches turn, it jumps back to restart
+/// or, with mirror, walks back from the last pixel sent.
+template <uint8_t bytesPerPixel, bool mirror>
+struct fabStepSource {
+	static const uint8_t cycles = 14;
+
+	const uint8_t * array;
+	const uint8_t * turn;
+	const uint8_t * restart;
+	intptr_t step;
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t byte;    // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ? noByte : array[offset];
+		if (++byte == bytesPerPixel) {
+			byte = 0;
+			array += step;
+			if (array == turn) {
+				if (mirror) {
+					array -= step;
+					step = -step;
+				} else {
+					array = restart;
+				}
+			}
+		}
+		return value;
+	}
+};
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends an array of bits encoded with a palette to the LEDs.
-	/// This is a compact method to store patterns, compressed 3x to 24x,
-	/// but with the overhead of a palette array.
-	///
-	/// @param[in] count   Size of the array in bytes
-	/// @param[in] array   Array of bitsPerPixel bits per pixels, where the
-	///                    number of bits is 1,2, 4 or 8.
-	/// @param[in] palette Palette array with one entry per color used.
-	///
-	/// 1bit  ->   6B palette
-	/// 2bits ->  12B palette
-	/// 4bits ->  48B palette
-	/// 8bits -> 768B palette
-	///
-	/// @note bitsPerPixel is a template constant to allow the compiler to
-	/// optimize the bit-masking code.
-	////////////////////////////////////////////////////////////////////////
-	template <const uint8_t bitsPerPixel, class pixelColors> // @note does not support uint32_t uint8_t.
-	static inline void sendPixels (
-			const uint16_t count,
-			const uint8_t * pixelArray,
-			const uint8_t * reds,
-			const uint8_t * greens,
-			const uint8_t * blues) __attribute__ ((always_inline));
+/// @brief Byte source walking a ring buffer view of a row-major array of
+/// height rows of width pixels, see sendRing(). Each row is sent from its
+/// column base, wrapping around at its end, and the rows from the row base,
+/// wrapping around at the end of the array. Pixel bytes are reordered like
+/// fabStepSource. indexType is the pixel index type of the LED strip.
+template <uint8_t bytesPerPixel, class indexType>
+struct fabRingSource {
+	static const uint8_t cycles = 40;
+
+	const uint8_t * pixel;   // Pixel sent next
+	const uint8_t * row;     // First pixel of its row
+	const uint8_t * rowEnd;  // End of its row
+	const uint8_t * array;
+	const uint8_t * end;     // End of the array
+	indexType rowBytes;
+	indexType columnBytes;   // Offset of the column base in a row
+	indexType width;
+	indexType left;          // Pixels left in the row
+	uint8_t step;            // Size of a pixel of the array
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t byte;            // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ? noByte : pixel[offset];
+		if (++byte == bytesPerPixel) {
+			byte = 0;
+			pixel += step;
+			if (pixel == rowEnd) {
+				pixel = row;
+			}
+			if (--left == 0) {
+				left = width;
+				row = (rowEnd == end) ? array : rowEnd;
+				rowEnd = row + rowBytes;
+				pixel = row + columnBytes;
+			}
+		}
+		return value;
+	}
+};
 
-	template <const uint8_t bitsPerPixel>
-	static inline void sendPixels (
-			const uint16_t count,
-			const uint8_t * pixelArray,
-			const uint8_t * palette) __attribute__ ((always_inline));
+/// @brief Byte source calling a pixel generator, see sendGenerated(), on
+/// the first byte of each pixel, and sending the bytes of the pixel in the
+/// LED strip native order like fabFlashPixelSource. cycles is the cost of
+/// the source without the generator.
+template <uint8_t bytesPerPixel, class pixelType, class generator>
+struct fabGeneratorSource {
+	static const uint8_t cycles = 10;
+
+	generator & gen;
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t byte;    // Byte of the pixel sent next
+	pixelType pixel;
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			gen(pixel);
+		}
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ?
+			noByte : ((const uint8_t *) &pixel)[offset];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
-	template <const uint8_t bitsPerPixel, class paletteColors>
-	static inline void sendPixels (
-			const uint16_t count,
-			const uint8_t * pixelArray,
-			const paletteColors * palette) __attribute__ ((always_inline));
+// Palette view: remap the color index, then rotate it within the palette.
+#define PALETTE_VIEW_INDEX(colorIndex)                                         \
+	((uint8_t) (((remap) ? remap[(colorIndex)] : (colorIndex)) + rotate) & andMask)
+
+/// @brief Byte source decoding a pixel array of 1, 2, 4 or 8-bit color
+/// indexes, sending the bytes of their palette entries, with the palette
+/// view of the color indexes (see sendPixels). With flash, the pixel array
+/// and the palette are stored in flash memory, and remap in RAM.
+template <uint8_t bitsPerPixel, uint8_t bytesPerPixel, bool flash = false>
+struct fabPaletteSource {
+	static const uint8_t cycles = flash ? 30 : 24;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+
+	const uint8_t * pixelArray;
+	const uint8_t * palette;
+	uint8_t rotate;
+	const uint8_t * remap;
+	uint8_t elem;   // Byte of the pixel array being decoded
+	uint8_t left;   // Color indexes left in elem
+	uint8_t byte;   // Byte of the palette entry sent next
+	const uint8_t * entry;
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			if (left == 0) {
+				elem = flash ? FAB_PGM_BYTE(pixelArray++) : *pixelArray++;
+				left = 8 / bitsPerPixel;
+			}
+			const uint8_t colorIndex = PALETTE_VIEW_INDEX(elem & andMask);
+			elem >>= bitsPerPixel;
+			left--;
+			entry = &palette[bytesPerPixel * colorIndex];
+		}
+		const uint8_t value = flash ? FAB_PGM_BYTE(&entry[byte]) : entry[byte];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Send an array that is remapped to a physical LED strip
-	/// of a different layout than the natural layout of the pixel array
-	/// @param[in] pixelMap An array mapping a physical pixel to an offset
-	///            in the array pixelMap[pix] = index
-	/// Note: the array size is not used as it is expected that it will be
-	/// at least as big as the largest index in the pixel map.
-	////////////////////////////////////////////////////////////////////////
-	template <class pixelType> 
-	static inline void sendPixelsRemap(
-			const uint16_t numPixels,
-			const uint16_t * pixelMap,
-			const pixelType * array) __attribute__ ((always_inline));
+/// @brief Byte source decoding a pixel array of 1, 2, 4 or 8-bit color
+/// indexes like fabPaletteSource, walking the pixels from index by step
+/// pixels, which may be negative to walk backwards. indexType is the pixel
+/// index type of the LED strip.
+template <uint8_t bitsPerPixel, uint8_t bytesPerPixel, class indexType = uint16_t>
+struct fabPaletteStepSource {
+	static const uint8_t cycles = 30;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+	static const uint8_t perByte = 8 / bitsPerPixel;
+
+	const uint8_t * pixelArray;
+	const uint8_t * palette;
+	uint8_t rotate;
+	const uint8_t * remap;
+	indexType index; // Pixel sent next
+	int16_t step;
+	uint8_t byte;   // Byte of the palette entry sent next
+	const uint8_t * entry;
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			const uint8_t elem = pixelArray[index / perByte] >>
+				((index % perByte) * bitsPerPixel);
+			const uint8_t colorIndex = PALETTE_VIEW_INDEX(elem & andMask);
+			entry = &palette[bytesPerPixel * colorIndex];
+			index += step;
+		}
+		const uint8_t value = entry[byte];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
-	template <const uint8_t bitsPerPixel, class pixelType>
-	static inline void sendPixelsRemap (
-			const uint16_t numPixels,
-			const uint16_t * pixelMap,
-			const uint8_t * pixelArray,
-			const pixelType * palette) __attribute__ ((always_inline));
+/// @brief Byte source decoding a pixel array of 1, 2, 4 or 8-bit color
+/// indexes, sending the bytes of split-plane palettes. planes holds one
+/// palette plane per byte in the LED strip native order, or NULL to send
+/// noPlane instead.
+template <uint8_t bitsPerPixel, uint8_t bytesPerPixel>
+struct fabPlanarSource {
+	static const uint8_t cycles = 24;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+
+	const uint8_t * pixelArray;
+	const uint8_t * planes[4];
+	uint8_t noPlane;
+	uint8_t elem;   // Byte of the pixel array being decoded
+	uint8_t left;   // Color indexes left in elem
+	uint8_t byte;   // Byte of the pixel sent next
+	uint8_t colorIndex;
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			if (left == 0) {
+				elem = *pixelArray++;
+				left = 8 / bitsPerPixel;
+			}
+			colorIndex = elem & andMask;
+			elem >>= bitsPerPixel;
+			left--;
+		}
+		const uint8_t * plane = planes[byte];
+		const uint8_t value = plane ? plane[colorIndex] : noPlane;
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
-	template <const uint8_t bitsPerPixel, class pixelType>
-	static inline void sendPixelsRemap (
-			const uint8_t numPixels,
-			const uint8_t * pixelMap,
-			const uint8_t * pixelArray,
-			const pixelType * palette) __attribute__ ((always_inline));
 
+/// @brief Byte source expanding run-length encoded pixels. Each run is a
+/// count byte of 1 to 255 pixels, followed by one pixel in the LED strip
+/// native order: {3, 0,0,255, 1, 255,0,0} is 3 pixels then 1 pixel.
+/// A count of 0 is an empty run, skipped: it does not wrap to 256 pixels.
+template <uint8_t bytesPerPixel>
+struct fabRleSource {
+	static const uint8_t cycles = 16;
+
+	const uint8_t * runs;   // Next run
+	const uint8_t * pixel;  // Pixel of the current run
+	uint8_t left;           // Pixels left in the current run
+	uint8_t byte;           // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			while (left == 0) {
+				left = runs[0];
+				pixel = &runs[1];
+				runs += 1 + bytesPerPixel;
+			}
+			left--;
+		}
+		const uint8_t value = pixel[byte];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Sends an array of 3 pixels per 16bit words to the LEDs
-	/// This yelds 32K colors, and saves 33% RAM without using a palette. 
-	/// 
-	/// the SRAM.
-	/// @brief Sends an array of 16-bit words to the LEDs. Each word encodes
-	/// one pixel with 64 levels (5 bits)
-	//
-	/// @note brightness is a template constant that controls the unused 3
-	/// bits of the color. Its value is from zero to 2. Often set to 0 when
-	/// LED strip is too bright.
-	////////////////////////////////////////////////////////////////////////
-	template <uint8_t brightness>
-	static inline void sendPixels(int count, uint16_t * pixelArray) __attribute__ ((always_inline));
+/// @brief Byte source expanding run-length encoded palette indexes. Each
+/// run is a count byte of 1 to 255 pixels, followed by a color index of the
+/// palette, which holds bytesPerPixel bytes per color in native order.
+/// A count of 0 is an empty run, skipped like in fabRleSource.
+template <uint8_t bytesPerPixel>
+struct fabRlePaletteSource {
+	static const uint8_t cycles = 20;
+
+	const uint8_t * runs;   // Next run
+	const uint8_t * palette;
+	const uint8_t * pixel;  // Palette entry of the current run
+	uint8_t left;           // Pixels left in the current run
+	uint8_t byte;           // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			while (left == 0) {
+				left = runs[0];
+				pixel = &palette[bytesPerPixel * runs[1]];
+				runs += 2;
+			}
+			left--;
+		}
+		const uint8_t value = pixel[byte];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
+/// @brief Byte source decoding a pixel array of 1, 2, 4 or 8-bit color
+/// indexes like fabPaletteSource, with a palette of 3 or 4-byte typed pixels
+/// of stride bytes, reordered to the LED strip native order like
+/// fabFlashPixelSource.
+template <uint8_t bitsPerPixel, uint8_t bytesPerPixel>
+struct fabTypedPaletteSource {
+	static const uint8_t cycles = 28;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+
+	const uint8_t * pixelArray;
+	const uint8_t * palette;
+	uint8_t rotate;
+	const uint8_t * remap;
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t stride; // Size of a palette entry
+	uint8_t elem;   // Byte of the pixel array being decoded
+	uint8_t left;   // Color indexes left in elem
+	uint8_t byte;   // Byte of the palette entry sent next
+	const uint8_t * entry;
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			if (left == 0) {
+				elem = *pixelArray++;
+				left = 8 / bitsPerPixel;
+			}
+			const uint8_t colorIndex = PALETTE_VIEW_INDEX(elem & andMask);
+			elem >>= bitsPerPixel;
+			left--;
+			entry = &palette[stride * colorIndex];
+		}
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ? noByte : entry[offset];
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
 
+/// @brief Byte source expanding 16-bit packed pixels, colors packed from red
+/// in the most significant bits down to white, to 8 bits with fabExpand().
+/// channels holds the color of each native byte: 0 red, 1 green, 2 blue,
+/// 3 white, or 0xFF to send noWhite.
+template <uint8_t bytesPerPixel, bool gamma,
+	uint8_t rBits, uint8_t gBits, uint8_t bBits, uint8_t wBits>
+struct fabPacked16Source {
+	static const uint8_t cycles = 24;
+	static const uint8_t bShift = wBits;
+	static const uint8_t gShift = bShift + bBits;
+	static const uint8_t rShift = gShift + gBits;
+
+	const uint16_t * array;
+	uint8_t channels[4];
+	uint8_t noWhite;
+	uint8_t byte;   // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		const uint16_t elem = *array;
+		uint8_t value;
+		switch (channels[byte]) {
+			case 0:
+				value = fabExpand<rBits, gamma>((elem >> rShift) & ((1 << rBits) - 1));
+				break;
+			case 1:
+				value = fabExpand<gBits, gamma>((elem >> gShift) & ((1 << gBits) - 1));
+				break;
+			case 2:
+				value = fabExpand<bBits, gamma>((elem >> bShift) & ((1 << bBits) - 1));
+				break;
+			case 3:
+				value = (wBits) ? fabExpand<wBits, gamma>(elem & ((1 << wBits) - 1)) : noWhite;
+				break;
+			default:
+				value = noWhite;
+				break;
+		}
+		if (++byte == bytesPerPixel) {
+			byte = 0;
+			array++;
+		}
+		return value;
+	}
+};
 
-	////////////////////////////////////////////////////////////////////////
-	/// @brief Waits long enough to trigger a LED strip reset
-	////////////////////////////////////////////////////////////////////////
-	static inline void refresh() {
-		if (protocol == SPI_BITBANG) {
-			// SPI: Reset LED strip to accept a refresh with 32bit start frame
-			// set to zero, and an end frame set to 0 or 0xFF (we use zero)
-			// of 16B supporting up to 256 pixels
-			spiSoftwareSendFrame(4+16, false);
-		} else {
-			// 1-wire: Delay next pixels to cause a refresh
-			delay(minMsRefresh);
+/// @brief Byte source dithering 16-bit colors in 8.8 fixed point to 8 bits
+/// with fabDither(). offsets holds the color of each native byte in pixels
+/// of stride colors, or 0xFF to send noByte. The threshold moves on by
+/// FAB_DITHER_PIXEL_STEP every pixel.
+template <uint8_t bytesPerPixel>
+struct fabDitherSource {
+	static const uint8_t cycles = 16;
+
+	const uint16_t * array;
+	uint8_t offsets[4];
+	uint8_t noByte;
+	uint8_t stride;    // Colors per pixel
+	uint8_t threshold;
+	uint8_t byte;      // Byte of the pixel sent next
+
+	inline uint8_t next() {
+		const uint8_t offset = offsets[byte];
+		const uint8_t value = (offset == 0xFF) ?
+			noByte : fabDither(array[offset], threshold);
+		if (++byte == bytesPerPixel) {
+			byte = 0;
+			array += stride;
+			threshold += FAB_DITHER_PIXEL_STEP;
 		}
+		return value;
 	}
 };
 
+/// @brief Byte source of 16-bit per color pixels for APA102 LEDs, sending
+/// the current level header of each pixel, then its blue, green and red PWM
+/// values, see fabHdrLevel(). The colors are scaled by (brightness+1)/256
+/// first. SPI LED strips only, the 32-bit math does not fit the low time of
+/// 1-wire LED strips.
+template <class pixelType>
+struct fabHdrSource {
+	static const uint8_t cycles = 120;
+
+	const pixelType * array;
+	uint8_t brightness;
+	uint8_t level;
+	uint8_t byte;   // Byte of the pixel sent next
+	uint16_t bgr[3];
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			bgr[0] = ((uint32_t) array->b * brightness + array->b) >> 8;
+			bgr[1] = ((uint32_t) array->g * brightness + array->g) >> 8;
+			bgr[2] = ((uint32_t) array->r * brightness + array->r) >> 8;
+			array++;
+			const uint16_t bg = (bgr[0] > bgr[1]) ? bgr[0] : bgr[1];
+			level = fabHdrLevel((bg > bgr[2]) ? bg : bgr[2]);
+			byte = 1;
+			return 0xE0 | level;
+		}
+		const uint8_t value = fabHdrColor(bgr[byte - 1], level);
+		byte = (byte + 1) & 3;
+		return value;
+	}
+};
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Class methods definition
+/// @brief Compositor layers, stacked by fabCompositor to resolve each pixel
+/// while it is sent, without a frame buffer. A layer has the constant
+/// cycles, its estimated CPU cost on the first byte of a pixel, a start()
+/// method called once before the send, outside its timing, to compute what
+/// the layer needs, a pixel() method called on the first byte of each pixel
+/// with the pixel index, of the indexType of the LED strip, and a blend()
+/// method combining each byte with the value of the layers below.
+/// Colors and palette entries are in the LED strip native order.
+///
+/// Layers keep their decoding state: declare them for each frame sent.
 ////////////////////////////////////////////////////////////////////////////////
 
-////////////////////////////////////////////////////////////////////////
-template<FAB_TDEF>
-avrBitbangLedStrip<FAB_TVAR>::avrBitbangLedStrip()
-{
-	// Digital out pin mode
-	// bitSet(portDDR, dataPortPin);
-	// DDR? |= 1U << dataPortPin;
-	switch (protocol) {
-		case TWO_PORT_SPLIT_BITBANG:
-		case TWO_PORT_INTLV_BITBANG:
-			// Init two ports as out, set to low state
-			SET_DDR_HIGH(dataPortId,  dataPortPin);
-			SET_DDR_HIGH(clockPortId, clockPortPin);
-			SET_PORT_LOW(dataPortId,  dataPortPin);
-			SET_PORT_LOW(clockPortId, clockPortPin);
-			break;
-		case EIGHT_PORT_BITBANG:
-			FAB_DDR(dataPortId, 0xFF); // all pins out
-			FAB_PORT(dataPortId, 0x00); // all pins low
-			break;
-		case SPI_BITBANG:
-			// Init both ports as out
-			SET_DDR_HIGH(dataPortId, dataPortPin);
-			SET_DDR_HIGH(clockPortId, clockPortPin);
-			// SPI: Reset LED strip to accept a refresh
-			spiSoftwareSendFrame(16, false);
-			break;
-		default:
-			// Init data port as out, set to low state
-			SET_DDR_HIGH(dataPortId, dataPortPin);
-			SET_PORT_LOW(dataPortId, dataPortPin);
-			break;
-	}
+/// @brief Unused compositor layer
+struct fabNoLayer {
+	static const uint8_t cycles = 0;
+
+	inline void start() {}
+
+	template <uint8_t bytesPerPixel, class indexType>
+	inline void pixel(const indexType) {}
+
+	inline void blend(const uint8_t, uint8_t &) {}
 };
 
-#ifndef DISABLE_DEBUG_METHOD
-template<FAB_TDEF>
-template <void printChar(const char *),void printInt(uint32_t)>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::debug(void)
-{
-	printChar("\nclass avrBitbangLedStrip<...>\n");
+/// @brief Compositor layer of a solid color
+struct fabFillLayer {
+	static const uint8_t cycles = 3;
 
-	printInt(CYCLES_PER_SEC/1000000);
-	printChar("MHz CPU, ");
-	printInt(NANOSECONDS(1000));
-	printChar(" picoseconds per cycle\n");
+	uint8_t color[4];
 
-	printChar("ONE  HIGH=");
-	printInt(high1);
-	printChar(" LOW=");
-	printInt(low1);
-	printChar(" cycles\n");
+	inline void start() {}
 
-	printChar("ZERO HIGH=");
-	printInt(high0);
-	printChar(" LOW=");
-	printInt(low0);
-	printChar(" cycles\n");
+	template <uint8_t bytesPerPixel, class indexType>
+	inline void pixel(const indexType) {}
 
-	switch (colors) {
-		case NONE: printChar("NONE"); break;
-		case RGB: printChar("RGB"); break;
-		case GRB: printChar("GRB"); break;
-		case BGR: printChar("BGR"); break;
-		case RGBW: printChar("RGBW"); break;
-		case GRBW: printChar("GRBW"); break;
-		case HBGR: printChar("HBGR"); break;
-		default: printChar("ERROR!"); break;
+	inline void blend(const uint8_t byte, uint8_t & value) {
+		value = color[byte];
 	}
+};
 
-	printChar(" REFRESH MSEC=");
-	printInt(minMsRefresh);
+/// @brief Compositor layer of a palette image covering the LED strip,
+/// packed like the palette sendPixels() pixel arrays.
+template <uint8_t bitsPerPixel>
+struct fabPaletteLayer {
+	static const uint8_t cycles = 18;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+
+	const uint8_t * pixelArray;
+	const uint8_t * palette;
+	uint8_t elem;   // Byte of the pixel array being decoded
+	uint8_t left;   // Color indexes left in elem
+	const uint8_t * entry;
+
+	inline void start() {}
+
+	template <uint8_t bytesPerPixel, class indexType>
+	inline void pixel(const indexType) {
+		if (left == 0) {
+			elem = *pixelArray++;
+			left = 8 / bitsPerPixel;
+		}
+		entry = &palette[bytesPerPixel * (elem & andMask)];
+		elem >>= bitsPerPixel;
+		left--;
+	}
 
-	printChar("\nDATA_PORT ");
-	switch(dataPortId) {
-		case A:
-			printChar("A.");
-			break;
-		case B:
-			printChar("B.");
-			break;
-		case C:
-			printChar("C.");
-			break;
-		case D:
-			printChar("D.");
-			break;
-		case E:
-			printChar("E.");
-			break;
-		case F:
-			printChar("F.");
-			break;
-		default:
-			printChar("UNKNOWN.");
+	inline void blend(const uint8_t byte, uint8_t & value) {
+		value = entry[byte];
 	}
-	printInt(dataPortPin);
-	printChar(", ");
+};
 
-	if (protocol >= PROTOCOL_SPI) {
-		printChar("CLOCK_PORT ");
-		switch(clockPortId) {
-			case A:
-				printChar("A.");
-				break;
-			case B:
-				printChar("B.");
-				break;
-			case C:
-				printChar("C.");
-				break;
-			case D:
-				printChar("D.");
-				break;
-			case E:
-				printChar("E.");
-				break;
-			case F:
-				printChar("F.");
-				break;
-			default:
-				printChar("UNKNOWN.");
+/// @brief Compositor layer of a palette sprite of length pixels drawn from
+/// pixel position, transparent where its color index is key. A key above
+/// the palette size draws every pixel. With additive, the sprite colors are
+/// added to the layers below, saturating at 255, for glows and highlights.
+/// indexType is the pixel index type of the LED strip.
+template <uint8_t bitsPerPixel, bool additive = false, class indexType = uint16_t>
+struct fabSpriteLayer {
+	static const uint8_t cycles = additive ? 28 : 24;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+
+	const uint8_t * pixelArray;
+	const uint8_t * palette;
+	indexType position;
+	indexType length;
+	uint16_t key;
+	uint8_t elem;   // Byte of the pixel array being decoded
+	uint8_t left;   // Color indexes left in elem
+	const uint8_t * entry;  // Palette entry of the pixel, NULL if transparent
+
+	inline void start() {}
+
+	template <uint8_t bytesPerPixel, class stripIndexType>
+	inline void pixel(const stripIndexType index) {
+		entry = NULL;
+		if ((indexType) (index - position) < length) {
+			if (left == 0) {
+				elem = *pixelArray++;
+				left = 8 / bitsPerPixel;
+			}
+			const uint8_t colorIndex = elem & andMask;
+			elem >>= bitsPerPixel;
+			left--;
+			if (colorIndex != key) {
+				entry = &palette[bytesPerPixel * colorIndex];
+			}
 		}
-		printInt(clockPortPin);
-		printChar(", ");
 	}
 
-	switch(protocol) {
-		case ONE_PORT_BITBANG:
-			printChar("ONE-PORT (bitbang)");
-			break;
-		case TWO_PORT_SPLIT_BITBANG:
-			printChar("TWO-PORT-SPLIT (bitbang)");
-			break;
-		case TWO_PORT_INTLV_BITBANG:
-			printChar("TWO-PORT-INTERLEAVED (bitbang)");
-			break;
-		case EIGHT_PORT_BITBANG:
-			printChar("HEIGHT-PORT (bitbang)");
-			break;
-		case ONE_PORT_PWM:
-			printChar("ONE-PORT (PWM)");
-			break;
-		case ONE_PORT_UART:
-			printChar("ONE-PORT (UART)");
-			break;
-		case SPI_BITBANG:
-			printChar("SPI (bitbang)");
-			break;
-		case SPI_HARDWARE:
-			printChar("SPI (hardware)");
-			break;
-		default:
-			printChar("PROTOCOL UNKNOWN");
+	inline void blend(const uint8_t byte, uint8_t & value) {
+		if (entry) {
+			if (additive) {
+				const uint8_t sum = value + entry[byte];
+				value = (sum < value) ? 0xFF : sum;
+			} else {
+				value = entry[byte];
+			}
+		}
 	}
-	printChar("\n");
-}
-#endif
+};
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendBytes(const uint16_t count, const uint8_t * array)
-{
-	switch (protocol) {
-		case ONE_PORT_BITBANG:
-			onePortSoftwareSendBytes(count, array);
-			break;
-		case TWO_PORT_SPLIT_BITBANG:
-		case TWO_PORT_INTLV_BITBANG:
-			// Note: the function will detect and handle modes I and S
-			twoPortSoftwareSendBytes(count, array);
-			break;
-		case EIGHT_PORT_BITBANG:
-			eightPortSoftwareSendBytes(count, array);
-			break;
-		case SPI_BITBANG:
-			spiSoftwareSendBytes(count, array);
+/// @brief Byte source stacking up to 4 compositor layers, layer0 at the
+/// bottom. Each byte sent is blended from the layers while the line is low,
+/// see sendComposited(). indexType is the pixel index type of the LED strip.
+template <uint8_t bytesPerPixel, class layer0, class layer1,
+	class layer2 = fabNoLayer, class layer3 = fabNoLayer,
+	class indexType = uint16_t>
+struct fabCompositor {
+	static const uint8_t cycles = 8 + layer0::cycles + layer1::cycles +
+		layer2::cycles + layer3::cycles;
+
+	layer0 & l0;
+	layer1 & l1;
+	layer2 & l2;
+	layer3 & l3;
+	indexType index; // Pixel sent next
+	uint8_t byte;   // Byte of the pixel sent next
+
+	/// @brief Starts the layers, before sending the first byte.
+	inline void start() {
+		l0.start();
+		l1.start();
+		l2.start();
+		l3.start();
+	}
+
+	inline uint8_t next() {
+		if (byte == 0) {
+			l0.template pixel<bytesPerPixel>(index);
+			l1.template pixel<bytesPerPixel>(index);
+			l2.template pixel<bytesPerPixel>(index);
+			l3.template pixel<bytesPerPixel>(index);
+			index++;
+		}
+		uint8_t value = 0;
+		l0.blend(byte, value);
+		l1.blend(byte, value);
+		l2.blend(byte, value);
+		l3.blend(byte, value);
+		if (++byte == bytesPerPixel) byte = 0;
+		return value;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Base class defining LED strip operations allowed.
+////////////////////////////////////////////////////////////////////////////////
+static const uint8_t blank[3] = {128,128,128};
+
+#define FAB_TDEF int16_t high1,             \
+		int16_t low1,               \
+		int16_t high0,              \
+		int16_t low0,               \
+		uint32_t minMsRefresh,      \
+		avrLedStripPort dataPortId, \
+		uint8_t dataPortPin,        \
+		avrLedStripPort clockPortId,\
+		uint8_t clockPortPin,       \
+		pixelFormat colors,         \
+		ledProtocol protocol,       \
+		class indexType
+
+#define FAB_TVAR high1, low1, high0, low0, minMsRefresh, dataPortId, dataPortPin, clockPortId, clockPortPin, colors, protocol, indexType
+
+/// @brief Class to drive LED strips. Relies on custom sendBytes() method to push data to LEDs
+/// indexType is the type of pixel and byte counts and indexes: uint16_t by
+/// default, for speed and code size on AVR, or uint32_t to drive more than
+/// 64K bytes of pixels on ARM, for example ws2812b<D,6,uint32_t>. Custom
+/// LED strips deriving from avrBitbangLedStrip can leave it out.
+//template<
+//	int16_t high1,          // Number of cycles high for logical one
+//	int16_t low1,           // Number of cycles  low for logical one
+//	int16_t high0,          // Number of cycles high for logical zero
+//	int16_t low0,           // Number of cycles  low for logical zero
+//	uint32_t minMsRefresh,  // Minimum milliseconds to wait to reset LED strip data stream
+//	avrLedStripPort dataPortId, // AVR port the LED strip is attached to
+//	uint8_t dataPortPin         // AVR port bit the LED strip is attached to
+//>
+template <FAB_TDEF = uint16_t>
+class avrBitbangLedStrip : public fabByteFilter<avrBitbangLedStrip<FAB_TVAR> >
+{
+	typedef fabByteFilter<avrBitbangLedStrip> filter;
+	static const uint8_t bytesPerPixel = IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
+	// LED strips driven in parallel, each getting a block of the array,
+	// or every lanes-th pixel when interleaved
+	static const uint8_t lanes = (protocol == TWO_PORT_SPLIT_BITBANG ||
+		protocol == TWO_PORT_INTLV_BITBANG) ? 2 :
+		(protocol == SPI_PARALLEL_BITBANG) ? clockPortPin - dataPortPin :
+		(protocol == EIGHT_PORT_BITBANG) ? clockPortPin - dataPortPin + 1 : 1;
+	typedef fabLaneEncoder<high1, low1, high0, bytesPerPixel,
+		(protocol == TWO_PORT_SPLIT_BITBANG) ? LANES_SPLIT : LANES_INTERLEAVED,
+		filter,
+		fabLane<dataPortId, dataPortPin>, fabLane<clockPortId, clockPortPin>,
+		fabNoLane, fabNoLane, fabNoLane, fabNoLane, fabNoLane, fabNoLane
+	> twoPortEncoder;
+
+	public:
+	/// Type of pixel and byte counts, see fabSegment
+	typedef indexType indexT;
+
+	/// True when the array is split in one block per LED strip driven in
+	/// parallel: sending fewer pixels moves the pixels between LED strips.
+	static const bool splitLanes = lanes > 1 &&
+		protocol != TWO_PORT_INTLV_BITBANG;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Constructor: Set selected dataPortId.dataPortPin to digital output
+	////////////////////////////////////////////////////////////////////////
+	avrBitbangLedStrip();
+	////////////////////////////////////////////////////////////////////////
+	~avrBitbangLedStrip() { };
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Prints to console the configuration
+	/// @note You must implement the print routines (see example)
+	////////////////////////////////////////////////////////////////////////
+	template <void printChar(const char *),void printInt(uint32_t)>
+#ifndef DISABLE_DEBUG_METHOD
+	static inline void debug(void);
+#endif
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Gamma correction and global brightness of the bytes sent,
+	/// see fabByteFilter
+	////////////////////////////////////////////////////////////////////////
+#ifdef FAB_BRIGHTNESS
+	using filter::brightness;
+	using filter::setBrightness;
+#endif
+	using filter::filterCycles;
+	using filter::filterByte;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends N bytes to the LED using bit-banging.
+	///
+	/// @param[in] count Number of bytes sent
+	/// @param[in] array Array of bytes to send
+	///
+	/// @warning
+	/// The caller must handle interupts!
+	/// If interupts are not off, the timer interupt will happen, and it takes
+	/// too long and will cause a LED strip reset.
+	///
+	/// @note
+	/// __attribute__ ((always_inline)) forces gcc to inline this function in
+	/// the caller, to optimize there and avoid function call overhead. The
+	/// timing is critical at 16MHz.
+	/// @note
+	/// __builtin_avr_delay_cycles() is a gcc built-in that will generate ASM
+	/// to implement the exact number of cycle delays specified using the most
+	/// compact instruction loop, and is portable.
+	/// @note
+	/// The AVR port bit-set math will be changed by gcc to a sbi/cbi in ASM
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	sendBytes(const indexType count, const uint8_t * array)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief APA102 framing state, SPI protocol only.
+	/// spiByteCount counts the bytes sent since the last start frame, to
+	/// locate the pixel header bytes and to size the end frame.
+	/// spiHeader is the 0b111xxxxx pixel header sent for pixels that carry
+	/// no brightness, set with setHeaderBrightness().
+	////////////////////////////////////////////////////////////////////////
+	static indexType spiByteCount;
+	static uint8_t spiHeader;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sets the APA102 5-bit global brightness [0..31] of the pixels
+	/// sent without a brightness header, for example rgb or palette pixels.
+	////////////////////////////////////////////////////////////////////////
+	static inline void setHeaderBrightness(const uint8_t level) {
+		spiHeader = 0xE0 | (level & 0x1F);
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends N bytes in a row set to zero or 0xFF, to build a frame
+	/// for each pixel, and for a whole strip, SPI protocol only
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	spiSoftwareSendFrame(const indexType count, bool high)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendBytes for the 1-port SPI protocol.
+	/// For HBGR LED strips, the top 3 bits of the first byte of each pixel
+	/// are forced to 1, as required by the APA102 pixel header.
+	/// Colors go through filterByte, unless filtered is false.
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	spiSoftwareSendBytes(
+			const indexType count,
+			const uint8_t * array,
+			const bool filtered = true)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendBytes for the parallel SPI protocol.
+	/// The data lines are the port pins dataPortPin to clockPortPin-1, and
+	/// the clock line is clockPortPin, all on the same port. The array is
+	/// split in as many blocks as data lines, one per LED strip. Each byte
+	/// of the LED strips is transposed to one port value per bit, written
+	/// with the clock low before the clock rising edge.
+	///
+	/// @warning This writes the whole port, other pins of the port are set
+	/// low.
+	////////////////////////////////////////////////////////////////////////
+	static const uint8_t spiLanes = clockPortPin - dataPortPin;
+	static const uint8_t spiLaneMask = ((1 << clockPortPin) - 1) & ~((1 << dataPortPin) - 1);
+
+	static inline void
+	spiParallelSoftwareSendBytes(
+			const indexType count,
+			const uint8_t * array,
+			const bool filtered = true)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendBytes for the 1-ports protocol
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	onePortSoftwareSendBytes(const indexType count, const uint8_t * array)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends numPixels pixels produced by a byte source, for example
+	/// fabPaletteSource. With the 1-wire protocol, the next byte is computed
+	/// while the line is low after the first bit of the current byte.
+	/// A byte source is read in order, while multi-lane protocols send a
+	/// pixel of every lane at once: interleaved multi-lane LED strips get
+	/// the pixels of the source in turn, one pixel per lane at a time, see
+	/// laneSendSource(). LED strips with split lanes do not support byte
+	/// sources.
+	///
+	/// @warning The caller must handle interupts!
+	////////////////////////////////////////////////////////////////////////
+	template <class byteSource>
+	static inline void
+	sendSource(const indexType numPixels, byteSource & source)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendSource for single lane LED strips.
+	////////////////////////////////////////////////////////////////////////
+	template <class byteSource>
+	static inline void
+	singleLaneSendSource(const indexType numPixels, byteSource & source)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendSource for multi-lane LED strips, one group of
+	/// one pixel per lane at a time, like sendRemapped(): pixel i of the
+	/// source goes to lane i % lanes, the interleaved array layout. A source
+	/// read in order cannot fill the blocks of a split layout, see
+	/// splitLanes, so those protocols are rejected. The group is read from
+	/// the source between two groups, with the data lines low, so on 1-wire
+	/// LED strips reading its lanes * bytesPerPixel bytes must fit
+	/// sourceCycles.
+	/// Sources that compute final PWM values, like fabHdrSource, set
+	/// filtered to false to skip filterByte, SPI protocols only.
+	////////////////////////////////////////////////////////////////////////
+	template <class byteSource>
+	static inline void
+	laneSendSource(
+			const indexType numPixels,
+			byteSource & source,
+			const bool filtered = true)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Maximum cycles of a byte source for sendSource(): a 1-wire
+	/// LED strip resets if the next byte takes longer. SPI LED strips hold
+	/// the clock, so their byte sources have no time limit. It is compared
+	/// to the estimated cycles of the byte source.
+	////////////////////////////////////////////////////////////////////////
+	static const int16_t sourceCycles = IS_PROTOCOL_SPI(protocol) ? 0x7FFF :
+		// Low time budget less the filter and the end of array test
+		(int16_t) CYCLES(FAB_MAX_LOW_NS) - low1 + cbiCycles - filterCycles - 4;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendSource for the 1-port protocol, as a 2-stage
+	/// pipeline: the byte sent, and the next byte being computed.
+	////////////////////////////////////////////////////////////////////////
+	template <class byteSource>
+	static inline void
+	onePortSoftwareSendSource(const indexType count, byteSource & source)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendSource for the SPI protocol, one pixel at a
+	/// time: SPI has no timing limit. Sources that compute final PWM
+	/// values, like fabHdrSource, set filtered to false to skip filterByte.
+	////////////////////////////////////////////////////////////////////////
+	template <class byteSource>
+	static inline void
+	spiSendSource(
+			const indexType numPixels,
+			byteSource & source,
+			const bool filtered = true)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendBytes for the 2-ports protocol
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	twoPortSoftwareSendBytes(const indexType count, const uint8_t * array)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendBytes for the 8-ports protocol
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	eightPortSoftwareSendBytes(const indexType count, const uint8_t * array)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends numPixels pixels of bytesPerPixel bytes, without the
+	/// byte count overflowing indexType.
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	sendPixelBytes(const indexType numPixels, const uint8_t * array)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Clears the LED strip
+	/// @param[in] numPixels  Number of pixels to erase
+	////////////////////////////////////////////////////////////////////////
+	static inline void clear( const indexType numPixels)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sets the LED strip to a grey value
+	/// @param[in] numPixels  Number of pixels to erase
+	/// @param[in] value      Brightness of the grey [0..255]
+	////////////////////////////////////////////////////////////////////////
+	static inline void grey(
+			const indexType numPixels,
+			const uint8_t value)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends pixels computed on the fly by a generator, without a
+	/// pixel array, for example a rainbow on 64K LEDs with 3 bytes of RAM.
+	/// The generator is a functor called once per pixel, in order:
+	///   void operator()(pixelType & pixel);
+	/// pixelType is a 3 or 4-byte pixel type. With C++ 11, the generator may
+	/// be a temporary or a lambda:
+	/// For example: myLeds.sendGenerated<rgb>(1000, myRainbow);
+	///              myLeds.sendGenerated<rgb>(8, [&](rgb & p) { p = c; });
+	///
+	/// @note The generator runs in a byte source, fabGeneratorSource, while
+	/// the data line is low after the first bit of the last byte of the
+	/// previous pixel, so a 1-wire LED strip resets unless it returns within
+	/// generatorCycles CPU cycles. Inline it, and check it with the
+	/// H_benchmark example. SPI LED strips hold the clock, so their
+	/// generators have no time limit. 1-wire multi-lane LED strips would
+	/// call it for a whole group of pixels while the lines are low, see
+	/// laneSendSource(), which this budget does not cover: they are
+	/// rejected at compile time.
+	////////////////////////////////////////////////////////////////////////
+	static const int16_t generatorCycles = IS_PROTOCOL_SPI(protocol) ? 0x7FFF :
+		// Byte source budget less the fabGeneratorSource byte test, call
+		// and native order lookup, about 10 cycles.
+		sourceCycles - 10;
+
+	template <class pixelType, class generator>
+	static inline void sendGenerated(
+			const indexType numPixels,
+			generator FAB_FORWARD_REF gen)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of 32bit words encoding 0x00bbrrgg to the LEDs
+	/// This is the standard encoding for most libraries and wastes 25% of
+	/// the SRAM.
+	///
+	/// @param[in] numPixels Number of pixels to write
+	/// @param[in] array     Array of 1 word per pixels in native order
+	///                      (most significant byte is ignored)
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixels(
+			const indexType numPixels,
+			const uint32_t * pixelArray)
+	__attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends 3-byte pixels to the LED strip.
+	/// This function should be the most common used method.
+	///
+	/// @note for SK6812, which uses 4 bytes per pixels, this method will send
+	/// 4 bytes per pixel and expect an array containing 4 bytes per pixel.
+	/// @param[in] numPixels Number of pixels to write
+	/// @param[in] array     Array of 3-bytes per pixels in native order
+	///                      (for example GBR for WS2812B LED strips)
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixels(
+			const indexType numPixels,
+			const uint8_t * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgbw * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const grbw * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const hbgr * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const grb * array) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const bgr * array) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of bits encoded with a palette to the LEDs.
+	/// This is a compact method to store patterns, compressed 3x to 24x,
+	/// but with the overhead of a palette array.
+	///
+	/// @param[in] count   Size of the array in bytes
+	/// @param[in] array   Array of bitsPerPixel bits per pixels, where the
+	///                    number of bits is 1,2, 4 or 8.
+	/// @param[in] palette Palette array with one entry per color used.
+	///
+	/// 1bit  ->   6B palette
+	/// 2bits ->  12B palette
+	/// 4bits ->  48B palette
+	/// 8bits -> 768B palette
+	///
+	/// @note bitsPerPixel is a template constant to allow the compiler to
+	/// optimize the bit-masking code.
+	///
+	/// @param[in] rotate  Palette view base offset: a pixel of color index i
+	///                    is displayed with palette entry (i + rotate) modulo
+	///                    the 2^bitsPerPixel palette size. Incrementing it
+	///                    every frame cycles the colors of the whole image.
+	/// @param[in] remap   Optional palette view remap table, indexed by color
+	///                    index, with one byte per palette entry. It replaces
+	///                    a color index by another one before rotation, to
+	///                    swap, flash or fade colors in one frame without
+	///                    modifying the pixel array or the palette.
+	///
+	/// @note Both palette view parameters cost O(palette) to update per frame
+	/// instead of O(pixels) to redraw the image. When left to their default
+	/// values, the compiler removes their code.
+	////////////////////////////////////////////////////////////////////////
+
+	template <const uint8_t bitsPerPixel>
+	static inline void sendPixels (
+			const indexType count,
+			const uint8_t * pixelArray,
+			const uint8_t * palette,
+			const uint8_t rotate = 0,
+			const uint8_t * remap = NULL) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel, class paletteColors>
+	static inline void sendPixels (
+			const indexType count,
+			const uint8_t * pixelArray,
+			const paletteColors * palette,
+			const uint8_t rotate = 0,
+			const uint8_t * remap = NULL) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of bits encoded with a split-plane palette,
+	/// where each color has its own palette array of one byte per entry.
+	/// Offsetting the plane pointers rotates each color independently.
+	///
+	/// @param[in] reds    Red palette plane
+	/// @param[in] greens  Green palette plane
+	/// @param[in] blues   Blue palette plane
+	/// @param[in] whites  Optional 4th plane: white for RGBW/GRBW LED strips,
+	///                    or brightness header for HBGR LED strips. When not
+	///                    provided, white is off and brightness is maximum.
+	///
+	/// @note The color bytes are read straight from the planes and streamed
+	/// in the LED strip native order, no pixel is built in between.
+	/// pixelColors is kept for compatibility and is not used anymore.
+	////////////////////////////////////////////////////////////////////////
+	template <const uint8_t bitsPerPixel, class pixelColors>
+	static inline void sendPixels (
+			const indexType count,
+			const uint8_t * pixelArray,
+			const uint8_t * reds,
+			const uint8_t * greens,
+			const uint8_t * blues,
+			const uint8_t * whites = NULL) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends run-length encoded pixels, expanded while streaming
+	/// with no pixel buffer, see fabRleSource and fabRlePaletteSource.
+	/// A flat scene of a few color runs fits in a few bytes of RAM.
+	///
+	/// @param[in] numPixels Number of pixels to send, all runs together
+	/// @param[in] runs      Runs of count and pixel in native order, or of
+	///                      count and color index when using a palette
+	/// @param[in] palette   Palette of pixels in native order
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixelsRLE(
+			const indexType numPixels,
+			const uint8_t * runs) __attribute__ ((always_inline));
+
+	static inline void sendPixelsRLE(
+			const indexType numPixels,
+			const uint8_t * runs,
+			const uint8_t * palette) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends pixels stored in flash memory with PROGMEM, to keep
+	/// large images, animations and palettes out of the 2KB of RAM of an
+	/// Arduino Uno. Flash reads run while the line is low, see sendSource.
+	///
+	/// The raw overload sends bytes in native order, the typed overload
+	/// reorders 3 and 4-byte pixels (rgb, grb, bgr, rgbw, grbw, hbgr) to the
+	/// LED strip native order, and the palette overload reads both the pixel
+	/// array and the palette from flash, with the palette view in RAM.
+	/// Packed and 16-bit pixel types (rgb565, rgb48...) are rejected at
+	/// compile time, send them from RAM with sendPixels().
+	///
+	/// Example:
+	/// const rgb image[64] PROGMEM = { ... };
+	/// strip.sendPixels_P(64, image);
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixels_P(
+			const indexType numPixels,
+			const uint8_t * array) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendPixels_P(
+			const indexType numPixels,
+			const pixelType * array) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel>
+	static inline void sendPixels_P(
+			const indexType count,
+			const uint8_t * pixelArray,
+			const uint8_t * palette,
+			const uint8_t rotate = 0,
+			const uint8_t * remap = NULL) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends a pattern of patternLen pixels repeated over numPixels
+	/// pixels, the last repetition cut short if needed, in one pass with
+	/// interrupts off and no gap between repetitions. A short pattern can
+	/// light a long strip with little RAM. An empty pattern sends nothing.
+	///
+	/// The raw overload takes pixels in the LED strip native order, the
+	/// typed overload reorders 3 and 4-byte pixels like sendPixels_P().
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendRepeated(
+			const uint8_t * pattern,
+			const indexType patternLen,
+			const indexType numPixels) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendRepeated(
+			const pixelType * pattern,
+			const indexType patternLen,
+			const indexType numPixels) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends numPixels pixels, then the same pixels in reverse
+	/// order, 2 * numPixels pixels in total, in one pass with interrupts off.
+	/// A symmetric installation needs only half of its pixels in RAM.
+	/// The total may exceed the indexType range, numPixels may not.
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendMirrored(
+			const uint8_t * array,
+			const indexType numPixels) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendMirrored(
+			const pixelType * array,
+			const indexType numPixels) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array in reverse order, last pixel first, for LED
+	/// strips wired backwards, with no remap table and no copy.
+	///
+	/// The raw overload takes pixels in the LED strip native order, the
+	/// typed overload reorders 3 and 4-byte pixels like sendPixels_P(), and
+	/// the palette overload takes the palette sendPixels() parameters.
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixelsReversed(
+			const indexType numPixels,
+			const uint8_t * array) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendPixelsReversed(
+			const indexType numPixels,
+			const pixelType * array) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel>
+	static inline void sendPixelsReversed(
+			const indexType count,
+			const uint8_t * pixelArray,
+			const uint8_t * palette,
+			const uint8_t rotate = 0,
+			const uint8_t * remap = NULL) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends every stride-th pixel of an array, starting at its first
+	/// pixel, for example one channel of an interleaved buffer. A negative
+	/// stride walks the array backwards. The byte step, stride times the
+	/// pixel size, is computed in 32 bits so that it does not overflow.
+	///
+	/// @param[in] first  Palette overload: index of the first pixel sent in
+	///                   the packed pixel array.
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendPixelsStrided(
+			const indexType numPixels,
+			const uint8_t * array,
+			const int16_t stride) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendPixelsStrided(
+			const indexType numPixels,
+			const pixelType * array,
+			const int16_t stride) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel>
+	static inline void sendPixelsStrided(
+			const indexType count,
+			const uint8_t * pixelArray,
+			const indexType first,
+			const int16_t stride,
+			const uint8_t * palette,
+			const uint8_t rotate = 0,
+			const uint8_t * remap = NULL) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends 2 to 4 layers composited on the fly, layer0 at the
+	/// bottom: fabPaletteLayer images, fabFillLayer colors, and
+	/// fabSpriteLayer sprites, with a transparent color or additive. No
+	/// frame buffer is used, so RAM scales with the layers, not the LEDs.
+	///
+	/// Each byte is blended while the line is low after the first bit of the
+	/// previous byte, so for 1-wire LED strips the fabCompositor cycles, the
+	/// sum of the estimated layer cycles, must fit sourceCycles, which is
+	/// asserted at compile time. The estimates are not measurements: check
+	/// a new composite with the H_benchmark example. 1-wire multi-lane LED
+	/// strips would blend a whole lane group while the lines are low, see
+	/// laneSendSource(), so they are rejected at compile time.
+	///
+	/// Example:
+	/// fabPaletteLayer<4> sky = {skyPixels, skyPalette};
+	/// fabSpriteLayer<2> ship = {shipPixels, shipPalette, x, 8, 0};
+	/// strip.sendComposited(numPixels, sky, ship);
+	///
+	/// Sprites on LED strips with a uint32_t indexType are positioned with
+	/// the same type: fabSpriteLayer<2, false, uint32_t>.
+	////////////////////////////////////////////////////////////////////////
+	template <class layer0, class layer1>
+	static inline void sendComposited(
+			const indexType numPixels,
+			layer0 & l0,
+			layer1 & l1) __attribute__ ((always_inline));
+
+	template <class layer0, class layer1, class layer2>
+	static inline void sendComposited(
+			const indexType numPixels,
+			layer0 & l0,
+			layer1 & l1,
+			layer2 & l2) __attribute__ ((always_inline));
+
+	template <class layer0, class layer1, class layer2, class layer3>
+	static inline void sendComposited(
+			const indexType numPixels,
+			layer0 & l0,
+			layer1 & l1,
+			layer2 & l2,
+			layer3 & l3) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Send an array that is remapped to a physical LED strip
+	/// of a different layout than the natural layout of the pixel array
+	/// @param[in] pixelMap An array mapping a physical pixel to an offset
+	///            in the array pixelMap[pix] = index
+	/// Note: the array size is not used as it is expected that it will be
+	/// at least as big as the largest index in the pixel map.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType> 
+	static inline void sendPixelsRemap(
+			const indexType numPixels,
+			const indexType * pixelMap,
+			const pixelType * array) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel, class pixelType>
+	static inline void sendPixelsRemap (
+			const indexType numPixels,
+			const indexType * pixelMap,
+			const uint8_t * pixelArray,
+			const pixelType * palette) __attribute__ ((always_inline));
+
+	template <const uint8_t bitsPerPixel, class pixelType>
+	static inline void sendPixelsRemap (
+			const uint8_t numPixels,
+			const uint8_t * pixelMap,
+			const uint8_t * pixelArray,
+			const pixelType * palette) __attribute__ ((always_inline));
+
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of 16-bit packed pixels to the LEDs.
+	/// This saves 33% RAM compared to 24-bit pixels without using a palette.
+	/// Each color is expanded to 8 bits with a flash lookup table, and sent
+	/// in the LED strip native order.
+	///
+	/// @note gamma is a template constant that selects gamma corrected
+	/// expansion tables: sendPixels<true>(count, pixelArray);
+	/// @note White of rgbw4444 pixels is dropped for 3-byte LED strips.
+	/// rgb565 and rgb555 pixels are sent with white off to RGBW LED strips,
+	/// and with max brightness to HBGR LED strips.
+	////////////////////////////////////////////////////////////////////////
+	template <bool gamma>
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb565 * pixelArray) __attribute__ ((always_inline));
+
+	template <bool gamma>
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb555 * pixelArray) __attribute__ ((always_inline));
+
+	template <bool gamma>
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgbw4444 * pixelArray) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb565 * pixelArray) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb555 * pixelArray) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgbw4444 * pixelArray) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of 16-bit per color pixels, in 8.8 fixed point,
+	/// with temporal dithering to 8 bits per color. Repeated frames of the
+	/// same pixels display the fraction through the average brightness,
+	/// which smoothes fades at low brightness levels.
+	///
+	/// @note Each call advances ditherFrame, which selects the threshold of
+	/// the frame. Each pixel offsets it by FAB_DITHER_PIXEL_STEP.
+	/// @note rgb48 pixels are sent with white off to RGBW LED strips.
+	/// @note HBGR LED strips are not dithered, they use sendPixelsHDR().
+	////////////////////////////////////////////////////////////////////////
+	static uint8_t ditherFrame;
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgb48 * pixelArray) __attribute__ ((always_inline));
+
+	static inline void sendPixels(
+			const indexType numPixels,
+			const rgbw64 * pixelArray) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of 16-bit per color pixels to APA102 LEDs with
+	/// a high dynamic range: the 5-bit header and 8-bit colors of each pixel
+	/// are computed on the fly while sending, without a second buffer.
+	/// The quantization error is below 0.6 PWM step of the level picked,
+	/// so dim pixels keep a precision close to 13 bits.
+	/// The colors are linear, FAB_GAMMA does not apply to them, and
+	/// FAB_BRIGHTNESS scales them before the level is picked.
+	/// @note White of rgbw64 pixels is ignored.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType>
+	static inline void sendPixelsHDR(
+			const indexType numPixels,
+			const pixelType * pixelArray) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendPixelsHDR, without its LED strip check, for
+	/// the 16-bit sendPixels() overloads that only call it on HBGR strips.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType>
+	static inline void hdrSendSource(
+			const indexType numPixels,
+			const pixelType * pixelArray) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends 2 LED strips of different lengths in one pass, for the
+	/// TWO_PORT_SPLIT_BITBANG protocol (ws2812bs). The shorter LED strip
+	/// idles low while the other one finishes.
+	///
+	/// @param[in] numPixels1 Number of pixels of the first port
+	/// @param[in] numPixels2 Number of pixels of the second port
+	/// @param[in] array      Pixels of the first port, then of the second
+	///                       port, in native order
+	////////////////////////////////////////////////////////////////////////
+	static inline void sendSegments(
+			const indexType numPixels1,
+			const indexType numPixels2,
+			const uint8_t * array) __attribute__ ((always_inline));
+
+	template <class pixelType>
+	static inline void sendSegments(
+			const indexType numPixels1,
+			const indexType numPixels2,
+			const pixelType * array) {
+		sendSegments(numPixels1, numPixels2, (const uint8_t *) array);
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends an array of 16-bit words encoding 0bxRRRRRGGGGGBBBBB
+	/// pixels, without expanding the 5-bit colors to 8 bits.
+	///
+	/// @note brightness is a template constant that shifts the 5-bit colors
+	/// left. Its value is from zero to 3. Often set to 0 when LED strip is
+	/// too bright.
+	////////////////////////////////////////////////////////////////////////
+	template <uint8_t brightness>
+	static inline void sendPixels(int count, uint16_t * pixelArray) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Writes a pixel's colors in the LED strip native byte order.
+	/// @param[out] bytes  Buffer of bytesPerPixel bytes
+	/// @param[in]  w      White, or brightness header for HBGR LED strips,
+	///                    ignored for 3-byte LED strips.
+	////////////////////////////////////////////////////////////////////////
+	static inline void toNativeOrder(
+			uint8_t * bytes,
+			const uint8_t r,
+			const uint8_t g,
+			const uint8_t b,
+			const uint8_t w) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends a ring buffer view of a row-major array of height rows
+	/// of width typed pixels, in one pass with interrupts off, see
+	/// fabRingSource. Row y sent is array row (rowBase + y) % height, from
+	/// its pixel columnBase, wrapping around. Used by fabRing, a single row,
+	/// and fabRing2D.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType>
+	static inline void sendRing(
+			const pixelType * array,
+			const indexType width,
+			const indexType height,
+			const indexType columnBase,
+			const indexType rowBase) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Computes the offset in a 3 or 4-byte pixelType of each byte
+	/// in the LED strip native order, 0xFF for a byte the pixel does not
+	/// have, and the value noByte sent for it.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType>
+	static inline void pixelOffsets(
+			uint8_t * offsets,
+			uint8_t & noByte) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Number of pixels of the next lane group, one pixel per lane,
+	/// out of the pixels left to send. The last group of the lane encoder
+	/// and parallel SPI protocols may be shorter, the 8-port protocol only
+	/// sends whole groups.
+	////////////////////////////////////////////////////////////////////////
+	static inline uint8_t groupPixels(const indexType pixelsLeft) {
+		return (protocol != EIGHT_PORT_BITBANG && pixelsLeft < lanes) ?
+			pixelsLeft : lanes;
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends typed pixels of another byte order than the LED strip,
+	/// converted one lane group at a time, so that multi-lane protocols get
+	/// each pixel in the lane of the array layout.
+	////////////////////////////////////////////////////////////////////////
+	template <class pixelType>
+	static inline void sendRemapped(
+			const indexType numPixels,
+			const pixelType * array) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends numPixels pixels walking an array, see fabStepSource.
+	/// A NULL turn walks straight, for reversed and strided sends.
+	/// The walk goes on for passes times numPixels pixels, in one pass with
+	/// interrupts off, so that mirrored sends of more than half the
+	/// indexType range do not overflow their pixel count.
+	////////////////////////////////////////////////////////////////////////
+	template <bool mirror>
+	static inline void sendStepped(
+			const indexType numPixels,
+			const uint8_t * array,
+			const intptr_t step,
+			const uint8_t * turn,
+			const uint8_t * offsets,
+			const uint8_t noByte,
+			const uint8_t passes = 1) __attribute__ ((always_inline));
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Implements sendPixels for 16-bit packed pixels, where colors
+	/// are packed from red in the most significant bits down to white.
+	////////////////////////////////////////////////////////////////////////
+	template <bool gamma, uint8_t rBits, uint8_t gBits, uint8_t bBits, uint8_t wBits>
+	static inline void sendPacked16(
+			const indexType numPixels,
+			const uint16_t * pixelArray) __attribute__ ((always_inline));
+
+
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Waits long enough to trigger a LED strip reset
+	////////////////////////////////////////////////////////////////////////
+	/// @note SPI LED strips must be refreshed after the last sendPixels of
+	/// every frame, to latch the pixels sent and start the next frame.
+	////////////////////////////////////////////////////////////////////////
+	static inline void refresh() {
+		if (IS_PROTOCOL_SPI(protocol)) {
+			// SPI: Each pixel delays the clock by half a cycle, so the end
+			// frame needs one clock per 2 pixels, aka ceil(n/16) bytes.
+			// It is followed by the 32bit start frame set to zero of the
+			// next frame.
+			spiSoftwareSendFrame((spiByteCount / 4 + 15) / 16, false);
+			spiSoftwareSendFrame(4, false);
+			spiByteCount = 0;
+		} else {
+			// 1-wire: Delay next pixels to cause a refresh
+			delay(minMsRefresh);
+		}
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Class methods definition
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+template<FAB_TDEF>
+avrBitbangLedStrip<FAB_TVAR>::avrBitbangLedStrip()
+{
+	// Digital out pin mode
+	// bitSet(portDDR, dataPortPin);
+	// DDR? |= 1U << dataPortPin;
+	switch (protocol) {
+		case TWO_PORT_SPLIT_BITBANG:
+		case TWO_PORT_INTLV_BITBANG:
+			// Init two ports as out, set to low state
+			SET_DDR_HIGH(dataPortId,  dataPortPin);
+			SET_DDR_HIGH(clockPortId, clockPortPin);
+			SET_PORT_LOW(dataPortId,  dataPortPin);
+			SET_PORT_LOW(clockPortId, clockPortPin);
+			break;
+		case EIGHT_PORT_BITBANG:
+			FAB_DDR(dataPortId, 0xFF); // all pins out
+			FAB_PORT(dataPortId, 0x00); // all pins low
+			break;
+		case SPI_BITBANG:
+			// Init both ports as out
+			SET_DDR_HIGH(dataPortId, dataPortPin);
+			SET_DDR_HIGH(clockPortId, clockPortPin);
+			// SPI: Send the start frame of the first refresh
+			spiSoftwareSendFrame(4, false);
+			break;
+		case SPI_PARALLEL_BITBANG:
+			// Init the data lines and the clock as out
+			for (uint8_t pin = dataPortPin; pin <= clockPortPin; pin++) {
+				SET_DDR_HIGH(dataPortId, pin);
+			}
+			spiSoftwareSendFrame(4, false);
+			break;
+		default:
+			// Init data port as out, set to low state
+			SET_DDR_HIGH(dataPortId, dataPortPin);
+			SET_PORT_LOW(dataPortId, dataPortPin);
+			break;
+	}
+};
+
+#ifndef DISABLE_DEBUG_METHOD
+template<FAB_TDEF>
+template <void printChar(const char *),void printInt(uint32_t)>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::debug(void)
+{
+	printChar("\nclass avrBitbangLedStrip<...>\n");
+
+	printInt(CYCLES_PER_SEC/1000000);
+	printChar("MHz CPU, ");
+	printInt(NANOSECONDS(1000));
+	printChar(" picoseconds per cycle\n");
+
+	printChar("ONE  HIGH=");
+	printInt(high1);
+	printChar(" LOW=");
+	printInt(low1);
+	printChar(" cycles\n");
+
+	printChar("ZERO HIGH=");
+	printInt(high0);
+	printChar(" LOW=");
+	printInt(low0);
+	printChar(" cycles\n");
+
+	switch (colors) {
+		case NONE: printChar("NONE"); break;
+		case RGB: printChar("RGB"); break;
+		case GRB: printChar("GRB"); break;
+		case BGR: printChar("BGR"); break;
+		case RGBW: printChar("RGBW"); break;
+		case GRBW: printChar("GRBW"); break;
+		case HBGR: printChar("HBGR"); break;
+		default: printChar("ERROR!"); break;
+	}
+
+	printChar(" REFRESH MSEC=");
+	printInt(minMsRefresh);
+
+	printChar("\nDATA_PORT ");
+	switch(dataPortId) {
+		case A:
+			printChar("A.");
+			break;
+		case B:
+			printChar("B.");
+			break;
+		case C:
+			printChar("C.");
+			break;
+		case D:
+			printChar("D.");
+			break;
+		case E:
+			printChar("E.");
+			break;
+		case F:
+			printChar("F.");
+			break;
+		default:
+			printChar("UNKNOWN.");
+	}
+	printInt(dataPortPin);
+	printChar(", ");
+
+	if (protocol >= PROTOCOL_SPI) {
+		printChar("CLOCK_PORT ");
+		switch(clockPortId) {
+			case A:
+				printChar("A.");
+				break;
+			case B:
+				printChar("B.");
+				break;
+			case C:
+				printChar("C.");
+				break;
+			case D:
+				printChar("D.");
+				break;
+			case E:
+				printChar("E.");
+				break;
+			case F:
+				printChar("F.");
+				break;
+			default:
+				printChar("UNKNOWN.");
+		}
+		printInt(clockPortPin);
+		printChar(", ");
+	}
+
+	switch(protocol) {
+		case ONE_PORT_BITBANG:
+			printChar("ONE-PORT (bitbang)");
+			break;
+		case TWO_PORT_SPLIT_BITBANG:
+			printChar("TWO-PORT-SPLIT (bitbang)");
+			break;
+		case TWO_PORT_INTLV_BITBANG:
+			printChar("TWO-PORT-INTERLEAVED (bitbang)");
+			break;
+		case EIGHT_PORT_BITBANG:
+			printChar("HEIGHT-PORT (bitbang)");
+			break;
+		case ONE_PORT_PWM:
+			printChar("ONE-PORT (PWM)");
+			break;
+		case ONE_PORT_UART:
+			printChar("ONE-PORT (UART)");
+			break;
+		case SPI_BITBANG:
+			printChar("SPI (bitbang)");
+			break;
+		case SPI_HARDWARE:
+			printChar("SPI (hardware)");
+			break;
+		case SPI_PARALLEL_BITBANG:
+			printChar("PARALLEL-SPI (bitbang)");
+			break;
+		default:
+			printChar("PROTOCOL UNKNOWN");
+	}
+	printChar("\n");
+}
+#endif
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendBytes(const indexType count, const uint8_t * array)
+{
+	switch (protocol) {
+		case ONE_PORT_BITBANG:
+			onePortSoftwareSendBytes(count, array);
+			break;
+		case TWO_PORT_SPLIT_BITBANG:
+		case TWO_PORT_INTLV_BITBANG:
+			// Note: the function will detect and handle modes I and S
+			twoPortSoftwareSendBytes(count, array);
+			break;
+		case EIGHT_PORT_BITBANG:
+			eightPortSoftwareSendBytes(count, array);
+			break;
+		case SPI_BITBANG:
+			spiSoftwareSendBytes(count, array);
+			break;
+		case SPI_PARALLEL_BITBANG:
+			spiParallelSoftwareSendBytes(count, array);
+			break;
+	}
+}
+
+template<FAB_TDEF>
+indexType avrBitbangLedStrip<FAB_TVAR>::spiByteCount = 0;
+
+template<FAB_TDEF>
+uint8_t avrBitbangLedStrip<FAB_TVAR>::spiHeader = 0xFF;
+
+// One SPI clock cycle, data is sampled on the rising edge
+#define SPI_CLOCK_PULSE()                                                      \
+	SET_PORT_LOW(clockPortId, clockPortPin);                               \
+	SET_PORT_HIGH(clockPortId, clockPortPin)
+
+// Set the data line to a bit of val selected by a constant mask, then pulse
+// the clock. gcc converts this to sbrc/sbrs with sbi/cbi on AVR.
+#define SPI_SEND_BIT(val, mask)                                                \
+	SET_PORT_LOW(clockPortId, clockPortPin);                               \
+	if ((val) & (mask)) {                                                  \
+		SET_PORT_HIGH(dataPortId, dataPortPin);                        \
+	} else {                                                               \
+		SET_PORT_LOW(dataPortId, dataPortPin);                         \
+	}                                                                      \
+	SET_PORT_HIGH(clockPortId, clockPortPin)
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::spiSoftwareSendFrame(const indexType count, bool high)
+{
+	if (protocol == SPI_PARALLEL_BITBANG) {
+		// All data lines at once, clock low
+		FAB_PORT(dataPortId, (high) ? spiLaneMask : 0x00);
+	} else if (high) {
+		SET_PORT_HIGH(dataPortId, dataPortPin);
+	} else {
+		SET_PORT_LOW(dataPortId, dataPortPin);
+	}
+	// The data line is constant: only toggle the clock, 8 times per byte
+	// with a 16-bit byte counter.
+	for(indexType c = count; c > 0; c--) {
+		SPI_CLOCK_PULSE(); SPI_CLOCK_PULSE();
+		SPI_CLOCK_PULSE(); SPI_CLOCK_PULSE();
+		SPI_CLOCK_PULSE(); SPI_CLOCK_PULSE();
+		SPI_CLOCK_PULSE(); SPI_CLOCK_PULSE();
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::spiSoftwareSendBytes(
+		const indexType count,
+		const uint8_t * array,
+		const bool filtered)
+{
+	// Track the pixel header position with an 8-bit copy of the byte count
+	uint8_t phase = spiByteCount;
+	spiByteCount += count;
+
+	for(indexType cnt = 0; cnt < count; ++cnt) {
+		// The header of APA102 pixels is 0b111bbbbb, b being brightness.
+		// Color bytes go through the gamma and brightness filter.
+		const bool isHeader = (colors == HBGR) && ((phase++ & 3) == 0);
+		const uint8_t val = (isHeader) ? (array[cnt] | 0xE0) :
+			(filtered) ? filterByte(array[cnt]) : array[cnt];
+		// To send a bit to SPI, set its value, then transtion clock low-high
+		SPI_SEND_BIT(val, 0x80);
+		SPI_SEND_BIT(val, 0x40);
+		SPI_SEND_BIT(val, 0x20);
+		SPI_SEND_BIT(val, 0x10);
+		SPI_SEND_BIT(val, 0x08);
+		SPI_SEND_BIT(val, 0x04);
+		SPI_SEND_BIT(val, 0x02);
+		SPI_SEND_BIT(val, 0x01);
+	}
+}
+
+// Byte l of the LED strips of the parallel SPI protocol, zero once its
+// block is sent. Lanes past spiLanes compile out.
+#define SPI_LANE_BYTE(l)                                                       \
+	uint8_t v##l = 0;                                                      \
+	if (spiLanes > l && cnt < blockBytes[l]) {                             \
+		const uint8_t val = block[l][cnt];                             \
+		v##l = (isHeader) ? (val | 0xE0) :                             \
+			(filtered) ? filterByte(val) : val;                    \
+	}
+
+// Data line of LED strip l set to the bit of its byte selected by mask
+#define SPI_LANE_BIT(l, mask)                                                  \
+	if (spiLanes > l && (v##l & (mask))) bits |= 1 << (dataPortPin + l);
+
+// Transposes one bit of every LED strip to one port value, written with the
+// clock low, then raises the clock. gcc converts each lane to sbrc/ori.
+#define SPI_LANES_SEND_BIT(mask) {                                             \
+	uint8_t bits = 0;                                                      \
+	SPI_LANE_BIT(0, mask) SPI_LANE_BIT(1, mask) SPI_LANE_BIT(2, mask)      \
+	SPI_LANE_BIT(3, mask) SPI_LANE_BIT(4, mask) SPI_LANE_BIT(5, mask)      \
+	SPI_LANE_BIT(6, mask)                                                  \
+	FAB_PORT(dataPortId, bits);                                            \
+	SET_PORT_HIGH(dataPortId, clockPortPin);                               \
+	}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::spiParallelSoftwareSendBytes(
+		const indexType count,
+		const uint8_t * array,
+		const bool filtered)
+{
+	STATIC_ASSERT(protocol != SPI_PARALLEL_BITBANG ||
+		(clockPortPin > dataPortPin && clockPortPin <= 7),
+		Clock_pin_must_follow_data_pins);
+
+	// Each LED strip gets a block of whole pixels. When the pixels do not
+	// divide evenly, the first LED strips get one more pixel, like
+	// fabLaneEncoder. The other LED strips get zero bytes after their last
+	// pixel, which start their end frame, see apa102x8.
+	const indexType numPixels = count / bytesPerPixel;
+	const indexType lanePixels = numPixels / spiLanes;
+	const uint8_t extraPixels = numPixels % spiLanes;
+	const indexType blockSize = (lanePixels + (extraPixels ? 1 : 0)) * bytesPerPixel;
+	const uint8_t * block[7];
+	indexType blockBytes[7];
+	for (uint8_t l = 0; l < spiLanes; l++) {
+		block[l] = (l == 0) ? array : block[l - 1] + blockBytes[l - 1];
+		blockBytes[l] = (l < extraPixels) ? blockSize : lanePixels * bytesPerPixel;
+	}
+	uint8_t phase = spiByteCount;
+	spiByteCount += blockSize;
+
+	for(indexType cnt = 0; cnt < blockSize; ++cnt) {
+		// Load one byte of each LED strip, with the APA102 header bits
+		const bool isHeader = (colors == HBGR) && ((phase++ & 3) == 0);
+		SPI_LANE_BYTE(0); SPI_LANE_BYTE(1); SPI_LANE_BYTE(2);
+		SPI_LANE_BYTE(3); SPI_LANE_BYTE(4); SPI_LANE_BYTE(5);
+		SPI_LANE_BYTE(6);
+
+		// One port value per bit, the clock rising after the data lines
+		SPI_LANES_SEND_BIT(0x80);
+		SPI_LANES_SEND_BIT(0x40);
+		SPI_LANES_SEND_BIT(0x20);
+		SPI_LANES_SEND_BIT(0x10);
+		SPI_LANES_SEND_BIT(0x08);
+		SPI_LANES_SEND_BIT(0x04);
+		SPI_LANES_SEND_BIT(0x02);
+		SPI_LANES_SEND_BIT(0x01);
+	}
+}
+
+/// @brief sends the array split across two ports each having half the LED strip to illuminate.
+/// To achieve this, we repurpose the clock port used for SPI as a second data port.
+/// We support two protocols:
+/// TWO_PORT_SPLIT_BITBANG: The array is split into 2 halves sent each sent to one of the ports
+/// TWO_PORT_INTLV_BITBANG: The array is interleaved and each pixel of 3 byte is sent to the next port
+/// Both are 2-lane cases of fabLaneEncoder. With an odd number of pixels,
+/// the first port gets one more pixel.
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::twoPortSoftwareSendBytes(const indexType count, const uint8_t * array)
+{
+	twoPortEncoder::sendBytes(count, array);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendSegments(
+		const indexType numPixels1,
+		const indexType numPixels2,
+		const uint8_t * array)
+{
+	STATIC_ASSERT(protocol == TWO_PORT_SPLIT_BITBANG,
+		Segments_need_the_split_protocol);
+
+	const indexType counts[2] = {numPixels1, numPixels2};
+
+	DISABLE_INTERRUPTS;
+	twoPortEncoder::sendSegments(counts, array);
+	RESTORE_INTERRUPTS;
+}
+
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::eightPortSoftwareSendBytes(const indexType count, const uint8_t * array)
+{
+	// The bytes are loaded within the bits, with no time left to filter them
+	STATIC_ASSERT(protocol != EIGHT_PORT_BITBANG || filterCycles == 0,
+		Eight_port_protocol_does_not_support_FAB_GAMMA_or_FAB_BRIGHTNESS);
+
+	const uint16_t bpp =  IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
+	const uint16_t blockSize __asm__("r14") = count / (clockPortPin - dataPortPin + 1) / bpp * bpp;
+
+	// Buffer one byte of each port in register
+	uint8_t r0 = 0; // __asm__("r2") = 0;
+	uint8_t r1 = 0; // __asm__("r3") = 0;
+	uint8_t r2 = 0; // __asm__("r4") = 0;
+	uint8_t r3 = 0; // __asm__("r5") = 0;
+	uint8_t r4 = 0; // __asm__("r6") = 0;
+	uint8_t r5 = 0; // __asm__("r7") = 0;
+	uint8_t r6 = 0; // __asm__("r8") = 0;
+	uint8_t r7 = 0; // __asm__("r9") = 0;
+
+	// Since bits for each port are sent delayed by one cycle to
+	// implement the memory access pipeline, we must leave the
+	// ports not yet in use set to LOW level. Once the pipeline
+	// is initialized fully onMask == 0xFF, and we always set it
+	// to high to send a zero or a one.
+	uint8_t onMask __asm__("r10") = 0;
+
+	for(uint16_t c __asm__("r12") = 0; c < blockSize ; ++c) {
+		for(int8_t b __asm__("r13") = 7; b >= 0; --b) {
+			uint8_t bitmask __asm__("r10") = 0;
+
+			// Load ONE byte per iteration
+			// Skip end condition check to reduce CPU cycles.
+			// It is expected that the LED strip won't have extra pixels.
+			switch (b) {
+				case 0:
+					// By checking statically if rX is read from memory, we
+					// avoid changing it, and the compiler will optimize out all
+					// the code including bitmask setting. On 16MHz Uno, we can
+					// only set bitmask for 6 ports before the strip resets.
+					if (0 == dataPortPin) {
+						onMask |= 1;
+						r0 = array[c];
+					}
+
+					if (r0 & 0b10000000) bitmask |= 1;
+					if (r1 & 0b01000000) bitmask |= 2;
+					if (r2 & 0b00100000) bitmask |= 4;
+					if (r3 & 0b00010000) bitmask |= 8;
+					if (r4 & 0b00001000) bitmask |= 16;
+					if (r5 & 0b00000100) bitmask |= 32;
+					if (r6 & 0b00000010) bitmask |= 64;
+					if (r7 & 0b00000001) bitmask |= 128;
+					break;
+				case 1:
+					if ((1 >= dataPortPin) && (1 <= clockPortPin)) {
+						onMask |= 2;
+						r1 = array[c + (1-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00000001) bitmask |= 1;
+					if (r1 & 0b10000000) bitmask |= 2;
+					if (r2 & 0b01000000) bitmask |= 4;
+					if (r3 & 0b00100000) bitmask |= 8;
+					if (r4 & 0b00010000) bitmask |= 16;
+					if (r5 & 0b00001000) bitmask |= 32;
+					if (r6 & 0b00000100) bitmask |= 64;
+					if (r7 & 0b00000010) bitmask |= 128;
+					break;
+				case 2:
+					if ((2 >= dataPortPin) && (2 <= clockPortPin)) {
+						onMask |= 4;
+						r2 = array[c + (2-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00000010) bitmask |= 1;
+					if (r1 & 0b00000001) bitmask |= 2;
+					if (r2 & 0b10000000) bitmask |= 4;
+					if (r3 & 0b01000000) bitmask |= 8;
+					if (r4 & 0b00100000) bitmask |= 16;
+					if (r5 & 0b00010000) bitmask |= 32;
+					if (r6 & 0b00001000) bitmask |= 64;
+					if (r7 & 0b00000100) bitmask |= 128;
+					break;
+				case 3:
+					if ((3 >= dataPortPin) && (3 <= clockPortPin)) {
+						onMask |= 8;
+						r3 = array[c + (3-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00000100) bitmask |= 1;
+					if (r1 & 0b00000010) bitmask |= 2;
+					if (r2 & 0b00000001) bitmask |= 4;
+					if (r3 & 0b10000000) bitmask |= 8;
+					if (r4 & 0b01000000) bitmask |= 16;
+					if (r5 & 0b00100000) bitmask |= 32;
+					if (r6 & 0b00010000) bitmask |= 64;
+					if (r7 & 0b00001000) bitmask |= 128;
+					break;
+				case 4:
+					if ((4 >= dataPortPin) && (4 <= clockPortPin)) {
+						onMask |= 16;
+						r4 = array[c + (4-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00001000) bitmask |= 1;
+					if (r1 & 0b00000100) bitmask |= 2;
+					if (r2 & 0b00000010) bitmask |= 4;
+					if (r3 & 0b00000001) bitmask |= 8;
+					if (r4 & 0b10000000) bitmask |= 16;
+					if (r5 & 0b01000000) bitmask |= 32;
+					if (r6 & 0b00100000) bitmask |= 64;
+					if (r7 & 0b00010000) bitmask |= 128;
+					break;
+				case 5:
+					if ((5 >= dataPortPin) && (5 <= clockPortPin)) {
+						onMask |= 32;
+						r5 = array[c + (5-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00010000) bitmask |= 1;
+					if (r1 & 0b00001000) bitmask |= 2;
+					if (r2 & 0b00000100) bitmask |= 4;
+					if (r3 & 0b00000010) bitmask |= 8;
+					if (r4 & 0b00000001) bitmask |= 16;
+					if (r5 & 0b10000000) bitmask |= 32;
+					if (r6 & 0b01000000) bitmask |= 64;
+					if (r7 & 0b00100000) bitmask |= 128;
+					break;
+				case 6:
+					if ((6 >= dataPortPin) && (6 <= clockPortPin)) {
+						onMask |= 64;
+						r6 = array[c + (6-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b00100000) bitmask |= 1;
+					if (r1 & 0b00010000) bitmask |= 2;
+					if (r2 & 0b00001000) bitmask |= 4;
+					if (r3 & 0b00000100) bitmask |= 8;
+					if (r4 & 0b00000010) bitmask |= 16;
+					if (r5 & 0b00000001) bitmask |= 32;
+					if (r6 & 0b10000000) bitmask |= 64;
+					if (r7 & 0b01000000) bitmask |= 128;
+					break;
+				case 7:
+					if ((7 >= dataPortPin) && (7 <= clockPortPin)) {
+						onMask |= 128;
+						r7 = array[c + (7-dataPortPin) * blockSize];
+					}
+
+					if (r0 & 0b01000000) bitmask |= 1;
+					if (r1 & 0b00100000) bitmask |= 2;
+					if (r2 & 0b00010000) bitmask |= 4;
+					if (r3 & 0b00001000) bitmask |= 8;
+					if (r4 & 0b00000100) bitmask |= 16;
+					if (r5 & 0b00000010) bitmask |= 32;
+					if (r6 & 0b00000001) bitmask |= 64;
+					if (r7 & 0b10000000) bitmask |= 128;
+					break;
+				}
+
+			// Set all HIGH, set LOW all zeros, set LOW zeros and ones.
+			FAB_PORT(dataPortId, onMask);
+			DELAY_CYCLES(high0 - sbiCycles);
+
+			FAB_PORT(dataPortId, bitmask);
+			DELAY_CYCLES( high1 - high0 + sbiCycles);
+
+			FAB_PORT(dataPortId, 0x00);
+			// Estimate overhead of math above to ~ 20 cycles
+			DELAY_CYCLES(low0 - cbiCycles - 20);
+		}
+	}
+}
+
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::onePortSoftwareSendBytes(const indexType count, const uint8_t * array)
+{
+	fabArraySource source = {array};
+	onePortSoftwareSendSource(count, source);
+}
+
+template<FAB_TDEF>
+template <class byteSource>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendSource(const indexType numPixels, byteSource & source)
+{
+	if (lanes > 1) {
+		laneSendSource(numPixels, source);
+	} else {
+		singleLaneSendSource(numPixels, source);
+	}
+}
+
+template<FAB_TDEF>
+template <class byteSource>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::singleLaneSendSource(const indexType numPixels, byteSource & source)
+{
+	if (protocol == ONE_PORT_BITBANG) {
+		// Send blocks of whole pixels, so the byte count fits indexType
+		const indexType maxPixels = ((indexType) -1) / bytesPerPixel;
+		indexType left = numPixels;
+		while (left > maxPixels) {
+			onePortSoftwareSendSource(maxPixels * bytesPerPixel, source);
+			left -= maxPixels;
+		}
+		onePortSoftwareSendSource(left * bytesPerPixel, source);
+	} else {
+		spiSendSource(numPixels, source);
+	}
+}
+
+template<FAB_TDEF>
+template <class byteSource>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::laneSendSource(
+		const indexType numPixels,
+		byteSource & source,
+		const bool filtered)
+{
+	// Pixel i of the source goes to lane i % lanes
+	STATIC_ASSERT(!splitLanes, Byte_sources_need_interleaved_lanes);
+
+	// The next group is read while the lines are low after the last one
+	STATIC_ASSERT(lanes == 1 || IS_PROTOCOL_SPI(protocol) ||
+		(int16_t) lanes * bytesPerPixel * byteSource::cycles <= sourceCycles,
+		Lane_group_source_exceeds_low_time);
+
+	for (indexType i = 0; i < numPixels; i += lanes) {
+		// Read one pixel of each lane, the 8-port protocol sends the lanes
+		// out of pixels black.
+		uint8_t group[lanes * bytesPerPixel];
+		const uint8_t count = groupPixels(numPixels - i);
+		for (uint8_t lane = 0; lane < count; lane++) {
+			const bool used = i + lane < numPixels;
+			for (uint8_t k = 0; k < bytesPerPixel; k++) {
+				group[lane * bytesPerPixel + k] = (used) ? source.next() : 0;
+			}
+		}
+		if (filtered) {
+			sendBytes(count * bytesPerPixel, group);
+		} else {
+			spiParallelSoftwareSendBytes(count * bytesPerPixel, group, false);
+		}
+	}
+}
+
+template<FAB_TDEF>
+template <class byteSource>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::spiSendSource(
+		const indexType numPixels,
+		byteSource & source,
+		const bool filtered)
+{
+	for (indexType i = 0; i < numPixels; i++) {
+		uint8_t pixel[bytesPerPixel];
+		for (uint8_t j = 0; j < bytesPerPixel; j++) {
+			pixel[j] = source.next();
+		}
+		if (filtered) {
+			sendBytes(bytesPerPixel, pixel);
+		} else if (protocol == SPI_PARALLEL_BITBANG) {
+			spiParallelSoftwareSendBytes(bytesPerPixel, pixel, false);
+		} else {
+			spiSoftwareSendBytes(bytesPerPixel, pixel, false);
+		}
+	}
+}
+
+/// Sends the most significant bit of val on the 1-wire data port.
+/// work runs while the line is low after the bit, and takes the place of
+/// workCycles cycles of the low time delay. The branches only hold the part
+/// of the low time that differs between a one and a zero, so work is
+/// expanded once, after them.
+#define ONE_PORT_SEND_MSB(val, work, workCycles)                               \
+	if ((val) & 0x80) {                                                    \
+		/* Send a ONE */                                               \
+		SET_PORT_HIGH(dataPortId, dataPortPin);                        \
+		DELAY_CYCLES(high1 - sbiCycles);                               \
+		SET_PORT_LOW(dataPortId, dataPortPin);                         \
+		DELAY_CYCLES(low1 - low0);                                     \
+	} else {                                                               \
+		/* Send a ZERO */                                              \
+		SET_PORT_HIGH(dataPortId, dataPortPin);                        \
+		DELAY_CYCLES(high0 - sbiCycles);                               \
+		SET_PORT_LOW(dataPortId, dataPortPin);                         \
+		DELAY_CYCLES(low0 - low1);                                     \
+	}                                                                      \
+	work;                                                                  \
+	DELAY_CYCLES(((low1 < low0) ? low1 : low0) - cbiCycles - (workCycles));
+
+template<FAB_TDEF>
+template <class byteSource>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::onePortSoftwareSendSource(const indexType count, byteSource & source)
+{
+	// Cost of the next byte: source, filter and end of array test
+	const int16_t nextCycles = byteSource::cycles + filterCycles + 4;
+
+	// The next byte is computed while the line is low after bit 7
+	STATIC_ASSERT(byteSource::cycles <= sourceCycles,
+		Byte_source_exceeds_low_time);
+
+	if (count == 0) {
+		return;
+	}
+
+	uint8_t next = filterByte(source.next());
+	for (indexType c = count; c > 0; c--) {
+		uint8_t val = next;
+
+		// Bit 7, then compute the next byte in the low time
+		ONE_PORT_SEND_MSB(val,
+			if (c > 1) next = filterByte(source.next()),
+			nextCycles);
+		val <<= 1;
+
+		for (int8_t b = 6; b >= 0; b--) {
+			ONE_PORT_SEND_MSB(val, (void) 0, 0);
+			val <<= 1;
+		}
+	}
+}
+
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::clear(const indexType numPixels)
+{
+	if (IS_PROTOCOL_SPI(protocol)) {
+		// SPI: Send numPixels black pixels with a valid header, and
+		// refresh to latch them.
+		for( indexType i = 0; i < numPixels; i++) {
+			spiSoftwareSendFrame(1, true);
+			spiSoftwareSendFrame(3, false);
+		}
+		spiByteCount += 4 * numPixels;
+		refresh();
+	} else {
+		// 1-wire: Delay next pixels to cause a refresh
+		// Multi-lane protocols send one pixel per lane at a time.
+		const uint8_t array[lanes * bytesPerPixel] = {0};
+
+ 		DISABLE_INTERRUPTS;
+		for( indexType i = 0; i < numPixels; i += lanes) {
+			sendBytes(groupPixels(numPixels - i) * bytesPerPixel, array);
+		}
+		RESTORE_INTERRUPTS;
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::grey(const indexType numPixels, const uint8_t value)
+{
+	uint8_t array[lanes * bytesPerPixel];
+	for (uint8_t i = 0; i < lanes * bytesPerPixel; i++) {
+		array[i] = value;
+	}
+
+	DISABLE_INTERRUPTS;
+	for( indexType i = 0; i < numPixels; i += lanes) {
+		sendBytes(groupPixels(numPixels - i) * bytesPerPixel, array);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class pixelType, class generator>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendGenerated(
+		const indexType numPixels,
+		generator FAB_FORWARD_REF gen)
+{
+	// The generator runs while the line is low, see sendSource: once per
+	// pixel on a single lane, which generatorCycles budgets, but for a
+	// whole lane group on 1-wire multi-lane LED strips.
+	STATIC_ASSERT(lanes == 1 || IS_PROTOCOL_SPI(protocol),
+		Generator_needs_a_single_lane_on_1_wire);
+
+	fabGeneratorSource<bytesPerPixel, pixelType, generator> source =
+		{gen, {0, 0, 0, 0}, 0, 0};
+	pixelOffsets<pixelType>(source.offsets, source.noByte);
+
+	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelBytes(
+		const indexType numPixels,
+		const uint8_t * array)
+{
+	// The byte count of an array can only overflow indexType when pointers
+	// are wider than indexType, for example 16-bit indexes on 32-bit ARM.
+	// Then send it in blocks. On AVR this test compiles to nothing.
+	if (sizeof(indexType) < sizeof(array)) {
+		const indexType maxPixels = ((indexType) ~0) / bytesPerPixel;
+		indexType remaining = numPixels;
+		while (remaining > maxPixels) {
+			sendBytes(maxPixels * bytesPerPixel, array);
+			array += (uint32_t) maxPixels * bytesPerPixel;
+			remaining -= maxPixels;
+		}
+		sendBytes(remaining * bytesPerPixel, array);
+	} else {
+		sendBytes(numPixels * bytesPerPixel, array);
+	}
+}
+
+// 3B raw input array
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const uint8_t * array)
+{
+ 	DISABLE_INTERRUPTS;
+	sendPixelBytes(numPixels, array);
+	RESTORE_INTERRUPTS;
+}
+
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendRemapped(
+		const indexType numPixels,
+		const pixelType * array)
+{
+	uint8_t offsets[4];
+	uint8_t noByte;
+	pixelOffsets<pixelType>(offsets, noByte);
+
+	// Pixels of each lane, the first lanes getting one more pixel when
+	// they do not divide evenly, like fabLaneEncoder
+	const indexType lanePixels = numPixels / lanes;
+	const uint8_t extraPixels = numPixels % lanes;
+
+	DISABLE_INTERRUPTS;
+	for (indexType i = 0; i < numPixels; i += lanes) {
+		// Convert one pixel of each lane, the 8-port protocol sends the
+		// lanes out of pixels black.
+		uint8_t group[lanes * bytesPerPixel];
+		const uint8_t count = groupPixels(numPixels - i);
+		const indexType pix = i / lanes;
+		for (uint8_t lane = 0; lane < count; lane++) {
+			uint8_t * bytes = &group[lane * bytesPerPixel];
+			if (pix == lanePixels && lane >= extraPixels) {
+				for (uint8_t k = 0; k < bytesPerPixel; k++) bytes[k] = 0;
+				continue;
+			}
+			const indexType pos = (lanes == 1) ? pix :
+				(protocol == TWO_PORT_INTLV_BITBANG) ? i + lane :
+				lane * lanePixels + pix +
+				((lane < extraPixels) ? lane : extraPixels);
+			const uint8_t * pixel = (const uint8_t *) &array[pos];
+			for (uint8_t k = 0; k < bytesPerPixel; k++) {
+				bytes[k] = (offsets[k] == 0xFF) ? noByte : pixel[offsets[k]];
+			}
+		}
+		sendBytes(count * bytesPerPixel, group);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+
+// 4B struct input arrays
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgbw * array)
+{
+	if (colors == RGBW || colors == NONE) {
+		// Native format, send as raw bytes
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else if (colors == RGB) {
+		// Output array is same order but 3B, send as 32bit, which will be converted
+		// because last byte will be dropped
+		sendPixels(numPixels, (const uint32_t *) array);
+	} else {
+		// Handle input array of different format than LED strip
+		sendRemapped(numPixels, array);
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const grbw * array)
+{
+	if (colors == GRBW || colors == NONE) {
+		// Native format, send as raw bytes
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else if (colors == GRB) {
+		// Output array is same order but 3B, send as 32bit, which will be converted
+		// because last byte will be dropped
+		sendPixels(numPixels, (const uint32_t *) array);
+	} else {
+		// Handle input array of different format than LED strip
+		sendRemapped(numPixels, array);
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const hbgr * array)
+{
+	if (colors == HBGR || colors == NONE) {
+		// Native format, send as raw bytes
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else if (colors == BGR) {
+		// Output array is same order but 3B, send as 32bit, which will be converted
+		// because last byte will be dropped
+		sendPixels(numPixels, (const uint32_t *) array);
+	} else {
+		// Handle input array of different format than LED strip
+		sendRemapped(numPixels, array);
+	}
+}
+
+// 3B struct input arrays
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb * array)
+{
+	if (colors == RGB || colors == NONE) {
+		// Input array is native format. No conversion.
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else {
+		// 4B, or 3B pixel array with different byte order, must be converted.
+		sendRemapped(numPixels, array);
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const grb * array)
+{
+	if (colors == GRB || colors == NONE) {
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else {
+		sendRemapped(numPixels, array);
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const bgr * array)
+{
+	if (colors == BGR || colors == NONE) {
+		sendPixels(numPixels, (const uint8_t *) array);
+	} else {
+		sendRemapped(numPixels, array);
+	}
+}
+
+// 4B raw input array
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const uint32_t * pixelArray)
+{
+ 	DISABLE_INTERRUPTS;
+
+	if IS_PIXEL_FORMAT_4B(colors) {
+		// 4 byte per pixel array, send all bytes.
+		sendPixelBytes(numPixels, (const uint8_t *) pixelArray);
+	} else {
+		// 3 byte per pixel array, send 3 out of 4 bytes.
+		for (indexType i=0; i< numPixels; i++) {
+			uint8_t * bytes = (uint8_t *) & pixelArray[i];
+			// For LED strips using 3 bytes per color, drop a byte.
+			sendBytes(bytesPerPixel, bytes);
+		}
+	}
+
+	RESTORE_INTERRUPTS;
+}
+
+// Planar palette input arrays
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel, class T>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels (
+		const indexType count,
+		const uint8_t * pixelArray,
+		const uint8_t * reds,
+		const uint8_t * greens,
+		const uint8_t * blues,
+		const uint8_t * whites)
+{
+	// Debug: Support simple palettes 2, 4, 16 or 256 colors
+
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		 bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	// Value of the 4th byte when there is no white/brightness plane
+	const uint8_t noWhite = (colors == HBGR) ? spiHeader : 0x00;
+
+	// Palette planes in the LED strip native order, the plane lookups run
+	// while the line is low, see sendSource
+	fabPlanarSource<bitsPerPixel, bytesPerPixel> source =
+		{pixelArray, {NULL, NULL, NULL, NULL}, noWhite, 0, 0, 0, 0};
+
+	// Since colors is a constant, the switch case will compile to 3 or 4
+	// assignments.
+	switch (colors) {
+		case RGB:
+		case NONE:
+			source.planes[0] = reds;
+			source.planes[1] = greens;
+			source.planes[2] = blues;
+			break;
+		case GRB:
+			source.planes[0] = greens;
+			source.planes[1] = reds;
+			source.planes[2] = blues;
+			break;
+		case BGR:
+			source.planes[0] = blues;
+			source.planes[1] = greens;
+			source.planes[2] = reds;
+			break;
+		case RGBW:
+			source.planes[0] = reds;
+			source.planes[1] = greens;
+			source.planes[2] = blues;
+			source.planes[3] = whites;
+			break;
+		case GRBW:
+			source.planes[0] = greens;
+			source.planes[1] = reds;
+			source.planes[2] = blues;
+			source.planes[3] = whites;
+			break;
+		case HBGR:
+			source.planes[0] = whites;
+			source.planes[1] = blues;
+			source.planes[2] = greens;
+			source.planes[3] = reds;
+			break;
+	}
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(count, source);
+	RESTORE_INTERRUPTS;
+}
+
+// Palette input arrays
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels (
+		const indexType count,
+		const uint8_t * pixelArray,
+		const uint8_t * palette,
+		const uint8_t rotate,
+		const uint8_t * remap)
+{
+	// Debug: Support simple palettes 2, 4, 16 or 256 colors
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		 bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	// The palette lookups run while the line is low, see sendSource
+	fabPaletteSource<bitsPerPixel, bytesPerPixel> source =
+		{pixelArray, palette, rotate, remap, 0, 0, 0, NULL};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(count, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel, class T>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels (
+		const indexType count,
+		const uint8_t * pixelArray,
+		const T * palette,
+		const uint8_t rotate,
+		const uint8_t * remap)
+{
+	// Debug: Support simple palettes 2, 4, 16 or 256 colors
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	// The palette lookups and reordering run while the line is low, see
+	// sendSource
+	fabTypedPaletteSource<bitsPerPixel, bytesPerPixel> source =
+		{pixelArray, (const uint8_t *) palette, rotate, remap,
+		{0, 0, 0, 0}, 0, sizeof(T), 0, 0, 0, NULL};
+	pixelOffsets<T>(source.offsets, source.noByte);
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(count, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsRLE(
+		const indexType numPixels,
+		const uint8_t * runs)
+{
+	fabRleSource<bytesPerPixel> source = {runs, NULL, 0, 0};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsRLE(
+		const indexType numPixels,
+		const uint8_t * runs,
+		const uint8_t * palette)
+{
+	fabRlePaletteSource<bytesPerPixel> source = {runs, palette, NULL, 0, 0};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels_P(
+		const indexType numPixels,
+		const uint8_t * array)
+{
+	fabFlashSource source = {array};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels_P(
+		const indexType numPixels,
+		const pixelType * array)
+{
+	STATIC_ASSERT(sizeof(pixelType) == (PT_IS_4B(pixelType::type) ? 4U : 3U),
+		sendPixels_P_needs_3_or_4_byte_pixel_types);
+
+	fabFlashPixelSource<bytesPerPixel> source =
+		{(const uint8_t *) array, {0, 0, 0, 0}, 0, sizeof(pixelType), 0};
+	pixelOffsets<pixelType>(source.offsets, source.noByte);
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels_P (
+		const indexType count,
+		const uint8_t * pixelArray,
+		const uint8_t * palette,
+		const uint8_t rotate,
+		const uint8_t * remap)
+{
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		 bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	fabPaletteSource<bitsPerPixel, bytesPerPixel, true> source =
+		{pixelArray, palette, rotate, remap, 0, 0, 0, NULL};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(count, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class pixelType> 
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap(
+		const indexType numPixels,
+		const indexType * pixelMap,
+		const pixelType * array)
+{
+	// The uint8_t raw type actually does not hold the whole pixel, it needs 3 bytes.
+	const indexType size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
+
+ 	DISABLE_INTERRUPTS;
+	for (indexType i = 0; i < numPixels; i += 1) {
+		const indexType ri = pixelMap[i];
+		sendPixels((indexType) 1, &array[size * ri]);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+// @note The 8bit per pixel works but 2bits per pixel does not at 16MHz.
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel, class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap (
+		const indexType numPixels,
+		const indexType * pixelMap,
+		const uint8_t * pixelArray,
+		const pixelType * palette)
+{
+	// Support only palettes with 2, 4, 16 or 256 colors
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	const indexType size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
+
+ 	DISABLE_INTERRUPTS;
+	for (indexType i = 0; i < numPixels; i++) {
+		// Remapped i: index in array of the next pixel to push.
+		const indexType ri = pixelMap[i];
+		// Extract color index via bitmasks
+		const uint8_t colorIndex = GET_PIXEL(pixelArray, ri, bitsPerPixel);
+		// Get the color/pixel to send
+		const pixelType * pixel =  &palette[size * colorIndex];
+		sendPixels(1, pixel);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel, class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap (
+		const uint8_t numPixels,
+		const uint8_t * pixelMap,
+		const uint8_t * pixelArray,
+		const pixelType * palette)
+{
+	// Support only palettes with 2, 4, 16 or 256 colors
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	const indexType size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
+
+ 	DISABLE_INTERRUPTS;
+	for (uint8_t i = 0; i < numPixels; i++) {
+		// Remapped i: index in array of the next pixel to push.
+		const uint8_t ri = pixelMap[i];
+		// Extract color index via bitmasks
+		const uint8_t colorIndex = GET_PIXEL(pixelArray, ri, bitsPerPixel);
+		// Get the color/pixel to send
+		const pixelType * pixel =  &palette[size * colorIndex];
+		sendPixels(1, pixel);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendRepeated(
+		const uint8_t * pattern,
+		const indexType patternLen,
+		const indexType numPixels)
+{
+	if (patternLen == 0) {
+		return;
+	}
+	const uint8_t offsets[4] = {0, 1, 2, 3};
+	sendStepped<false>(numPixels, pattern, bytesPerPixel,
+		pattern + patternLen * bytesPerPixel, offsets, 0);
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendRepeated(
+		const pixelType * pattern,
+		const indexType patternLen,
+		const indexType numPixels)
+{
+	if (patternLen == 0) {
+		return;
+	}
+	uint8_t offsets[4];
+	uint8_t noByte;
+	pixelOffsets<pixelType>(offsets, noByte);
+	sendStepped<false>(numPixels, (const uint8_t *) pattern,
+		sizeof(pixelType), (const uint8_t *) &pattern[patternLen],
+		offsets, noByte);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendMirrored(
+		const uint8_t * array,
+		const indexType numPixels)
+{
+	// The source turns back at the end of the array: send numPixels pixels
+	// twice rather than 2 * numPixels, which may overflow indexType.
+	const uint8_t offsets[4] = {0, 1, 2, 3};
+	sendStepped<true>(numPixels, array, bytesPerPixel,
+		array + numPixels * bytesPerPixel, offsets, 0, 2);
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendMirrored(
+		const pixelType * array,
+		const indexType numPixels)
+{
+	uint8_t offsets[4];
+	uint8_t noByte;
+	pixelOffsets<pixelType>(offsets, noByte);
+	sendStepped<true>(numPixels, (const uint8_t *) array,
+		sizeof(pixelType), (const uint8_t *) &array[numPixels],
+		offsets, noByte, 2);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsReversed(
+		const indexType numPixels,
+		const uint8_t * array)
+{
+	if (numPixels > 0) {
+		sendPixelsStrided(numPixels,
+			array + (numPixels - 1) * bytesPerPixel, -1);
+	}
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsReversed(
+		const indexType numPixels,
+		const pixelType * array)
+{
+	if (numPixels > 0) {
+		sendPixelsStrided(numPixels, &array[numPixels - 1], -1);
+	}
+}
+
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsReversed(
+		const indexType count,
+		const uint8_t * pixelArray,
+		const uint8_t * palette,
+		const uint8_t rotate,
+		const uint8_t * remap)
+{
+	if (count > 0) {
+		sendPixelsStrided<bitsPerPixel>(count, pixelArray, count - 1, -1,
+			palette, rotate, remap);
+	}
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsStrided(
+		const indexType numPixels,
+		const uint8_t * array,
+		const int16_t stride)
+{
+	const uint8_t offsets[4] = {0, 1, 2, 3};
+	sendStepped<false>(numPixels, array,
+		(intptr_t) ((int32_t) stride * bytesPerPixel), NULL, offsets, 0);
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsStrided(
+		const indexType numPixels,
+		const pixelType * array,
+		const int16_t stride)
+{
+	uint8_t offsets[4];
+	uint8_t noByte;
+	pixelOffsets<pixelType>(offsets, noByte);
+	sendStepped<false>(numPixels, (const uint8_t *) array,
+		(intptr_t) ((int32_t) stride * (int32_t) sizeof(pixelType)),
+		NULL, offsets, noByte);
+}
+
+template<FAB_TDEF>
+template <const uint8_t bitsPerPixel>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsStrided(
+		const indexType count,
+		const uint8_t * pixelArray,
+		const indexType first,
+		const int16_t stride,
+		const uint8_t * palette,
+		const uint8_t rotate,
+		const uint8_t * remap)
+{
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		 bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+
+	fabPaletteStepSource<bitsPerPixel, bytesPerPixel, indexType> source =
+		{pixelArray, palette, rotate, remap, first, stride, 0, NULL};
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(count, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class layer0, class layer1>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendComposited(
+		const indexType numPixels,
+		layer0 & l0,
+		layer1 & l1)
+{
+	fabNoLayer none;
+	sendComposited(numPixels, l0, l1, none, none);
+}
+
+template<FAB_TDEF>
+template <class layer0, class layer1, class layer2>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendComposited(
+		const indexType numPixels,
+		layer0 & l0,
+		layer1 & l1,
+		layer2 & l2)
+{
+	fabNoLayer none;
+	sendComposited(numPixels, l0, l1, l2, none);
+}
+
+template<FAB_TDEF>
+template <class layer0, class layer1, class layer2, class layer3>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendComposited(
+		const indexType numPixels,
+		layer0 & l0,
+		layer1 & l1,
+		layer2 & l2,
+		layer3 & l3)
+{
+	// Each byte is blended while the line is low, see sendSource: the
+	// compositor cycles are budgeted per byte, not per lane group.
+	STATIC_ASSERT(lanes == 1 || IS_PROTOCOL_SPI(protocol),
+		Compositor_needs_a_single_lane_on_1_wire);
+
+	fabCompositor<bytesPerPixel, layer0, layer1, layer2, layer3, indexType> source =
+		{l0, l1, l2, l3, 0, 0};
+	source.start();
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <bool mirror>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendStepped(
+		const indexType numPixels,
+		const uint8_t * array,
+		const intptr_t step,
+		const uint8_t * turn,
+		const uint8_t * offsets,
+		const uint8_t noByte,
+		const uint8_t passes)
+{
+	fabStepSource<bytesPerPixel, mirror> source =
+		{array, turn, array, step, {0, 0, 0, 0}, noByte, 0};
+	for (uint8_t i = 0; i < 4; i++) {
+		source.offsets[i] = offsets[i];
+	}
+
+ 	DISABLE_INTERRUPTS;
+	for (uint8_t i = 0; i < passes; i++) {
+		sendSource(numPixels, source);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendRing(
+		const pixelType * array,
+		const indexType width,
+		const indexType height,
+		const indexType columnBase,
+		const indexType rowBase)
+{
+	const uint8_t * pixels = (const uint8_t *) array;
+	const indexType rowBytes = width * sizeof(pixelType);
+	const uint8_t * row = pixels + rowBase * rowBytes;
+	fabRingSource<bytesPerPixel, indexType> source = {
+		row + columnBase * sizeof(pixelType), row, row + rowBytes,
+		pixels, pixels + height * rowBytes,
+		rowBytes, (indexType) (columnBase * sizeof(pixelType)),
+		width, width, sizeof(pixelType), {0, 0, 0, 0}, 0, 0};
+	pixelOffsets<pixelType>(source.offsets, source.noByte);
+
+	DISABLE_INTERRUPTS;
+	sendSource(width * height, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::pixelOffsets(
+		uint8_t * offsets,
+		uint8_t & noByte)
+{
+	const uint8_t type = pixelType::type;
+	STATIC_ASSERT(sizeof(pixelType) == (PT_IS_4B(type) ? 4U : 3U),
+		Pixel_type_needs_8bit_colors);
+
+	// Offsets of the colors in a pixel, after the brightness header if any
+	const uint8_t order = type & PT_COL;
+	const uint8_t first = PT_HAS_BRIGHT(type) ? 1 : 0;
+	const uint8_t r = first + ((order == PT_RGB) ? 0 : (order == PT_GRB) ? 1 : 2);
+	const uint8_t g = first + ((order == PT_GRB) ? 0 : 1);
+	const uint8_t b = first + ((order == PT_BGR) ? 0 : 2);
+	const uint8_t w = PT_HAS_WHITE(type) ? 3 : PT_HAS_BRIGHT(type) ? 0 : 0xFF;
+
+	// Value of the 4th byte when the pixel has no white/brightness
+	noByte = (colors == HBGR) ? spiHeader : 0x00;
+
+	toNativeOrder(offsets, r, g, b, w);
+}
+
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::toNativeOrder(
+		uint8_t * bytes,
+		const uint8_t r,
+		const uint8_t g,
+		const uint8_t b,
+		const uint8_t w)
+{
+	switch (colors) {
+		case NONE:
+		case RGB:
+			bytes[0] = r; bytes[1] = g; bytes[2] = b;
+			break;
+		case GRB:
+			bytes[0] = g; bytes[1] = r; bytes[2] = b;
+			break;
+		case BGR:
+			bytes[0] = b; bytes[1] = g; bytes[2] = r;
+			break;
+		case RGBW:
+			bytes[0] = r; bytes[1] = g; bytes[2] = b; bytes[3] = w;
+			break;
+		case GRBW:
+			bytes[0] = g; bytes[1] = r; bytes[2] = b; bytes[3] = w;
 			break;
+		case HBGR:
+			bytes[0] = w; bytes[1] = b; bytes[2] = g; bytes[3] = r;
+			break;
+	}
+}
+
+template<FAB_TDEF>
+template <bool gamma, uint8_t rBits, uint8_t gBits, uint8_t bBits, uint8_t wBits>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPacked16(
+		const indexType numPixels,
+		const uint16_t * pixelArray)
+{
+	// Default white or brightness when the pixel has none
+	const uint8_t noWhite = (colors == HBGR) ? spiHeader : 0x00;
+
+	// The expansion runs while the line is low, see sendSource
+	fabPacked16Source<bytesPerPixel, gamma, rBits, gBits, bBits, wBits> source =
+		{pixelArray, {0, 0, 0, 0}, noWhite, 0};
+	toNativeOrder(source.channels, 0, 1, 2, 3);
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+// 16-bit packed input arrays
+template<FAB_TDEF>
+template <bool gamma>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb565 * pixelArray)
+{
+	sendPacked16<gamma, 5, 6, 5, 0>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+template <bool gamma>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb555 * pixelArray)
+{
+	sendPacked16<gamma, 5, 5, 5, 0>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+template <bool gamma>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgbw4444 * pixelArray)
+{
+	sendPacked16<gamma, 4, 4, 4, 4>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb565 * pixelArray)
+{
+	sendPacked16<false, 5, 6, 5, 0>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb555 * pixelArray)
+{
+	sendPacked16<false, 5, 5, 5, 0>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgbw4444 * pixelArray)
+{
+	sendPacked16<false, 4, 4, 4, 4>(numPixels, (const uint16_t *) pixelArray);
+}
+
+template<FAB_TDEF>
+uint8_t avrBitbangLedStrip<FAB_TVAR>::ditherFrame = 0;
+
+// 16-bit per color input arrays
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixelsHDR(
+		const indexType numPixels,
+		const pixelType * pixelArray)
+{
+	// fabHdrSource computes 4-byte pixels with a brightness header, and
+	// being SPI, the LED strip has no low time budget for it.
+	STATIC_ASSERT(colors == HBGR && IS_PROTOCOL_SPI(protocol),
+		HDR_needs_an_HBGR_SPI_LED_strip);
+
+	hdrSendSource(numPixels, pixelArray);
+}
+
+template<FAB_TDEF>
+template <class pixelType>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::hdrSendSource(
+		const indexType numPixels,
+		const pixelType * pixelArray)
+{
+#ifdef FAB_BRIGHTNESS
+	fabHdrSource<pixelType> source = {pixelArray, brightness, 0, 0, {0, 0, 0}};
+#else
+	fabHdrSource<pixelType> source = {pixelArray, 255, 0, 0, {0, 0, 0}};
+#endif
+
+	DISABLE_INTERRUPTS;
+	// The PWM values are computed for a linear output: skip filterByte
+	if (lanes > 1) {
+		laneSendSource(numPixels, source, false);
+	} else {
+		spiSendSource(numPixels, source, false);
+	}
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgb48 * pixelArray)
+{
+	if (colors == HBGR) {
+		hdrSendSource(numPixels, pixelArray);
+		return;
+	}
+
+	// The dithering runs while the line is low, see sendSource
+	fabDitherSource<bytesPerPixel> source = {(const uint16_t *) pixelArray,
+		{0, 0, 0, 0}, 0x00, 3, fabDitherThreshold(ditherFrame++), 0};
+	toNativeOrder(source.offsets, 0, 1, 2, 0xFF);
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		const indexType numPixels,
+		const rgbw64 * pixelArray)
+{
+	if (colors == HBGR) {
+		hdrSendSource(numPixels, pixelArray);
+		return;
+	}
+
+	fabDitherSource<bytesPerPixel> source = {(const uint16_t *) pixelArray,
+		{0, 0, 0, 0}, 0x00, 4, fabDitherThreshold(ditherFrame++), 0};
+	toNativeOrder(source.offsets, 0, 1, 2, 3);
+
+ 	DISABLE_INTERRUPTS;
+	sendSource(numPixels, source);
+	RESTORE_INTERRUPTS;
+}
+
+template<FAB_TDEF>
+template <uint8_t brightness>
+inline void
+avrBitbangLedStrip<FAB_TVAR>::sendPixels(
+		int count,
+		uint16_t * pixelArray)
+{
+	const uint8_t noWhite = (colors == HBGR) ? spiHeader : 0x00;
+	uint8_t bytes[4];
+
+	// Debug: Support brightness 0..3
+	STATIC_ASSERT(brightness <= 3, Unsupported_brightness_level);
+
+ 	DISABLE_INTERRUPTS;
+
+	for (int i = 0; i < count; i++) {
+		const uint16_t elem = pixelArray[i]; 
+		toNativeOrder(bytes,
+			((elem >> 10) & 0x1F) << brightness,
+			((elem >>  5) & 0x1F) << brightness,
+			( elem        & 0x1F) << brightness,
+			noWhite);
+		sendBytes(bytesPerPixel, bytes);
+	}
+
+	RESTORE_INTERRUPTS;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Class to drive 1 to 8 1-wire LED strips in parallel, on any mix of
+/// port pins declared with fabLane. The pixel array holds the pixels of all
+/// the LED strips, split in one block per lane or interleaved, for example:
+/// ws2812bn<LANES_SPLIT, fabLane<D,6>, fabLane<D,7>, fabLane<B,0> > strips;
+////////////////////////////////////////////////////////////////////////////////
+template<
+	int16_t high1,
+	int16_t low1,
+	int16_t high0,
+	int16_t low0,
+	uint32_t minMsRefresh,
+	pixelFormat colors,
+	laneLayout layout,
+	FAB_LANES_TDEF,
+	class indexType>
+class avrBitbangLedLanes : public fabByteFilter<avrBitbangLedLanes<high1,
+	low1, high0, low0, minMsRefresh, colors, layout, FAB_LANES_TVAR,
+	indexType> >
+{
+	typedef fabByteFilter<avrBitbangLedLanes> filter;
+	static const uint8_t bytesPerPixel = IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
+	typedef fabLaneEncoder<high1, low1, high0, bytesPerPixel, layout,
+		filter, FAB_LANES_TVAR> encoder;
+
+	/// True if pixelType has the byte order of the LED strip, any 3-byte
+	/// pixel type for the NONE format.
+	template <class pixelType>
+	struct isNative {
+		static const bool value = sizeof(pixelType) == bytesPerPixel &&
+			((colors == NONE) ? PT_IS_3B(pixelType::type) :
+			pixelType::type == PIXEL_FORMAT_TYPE(colors));
+	};
+
+	public:
+	static const uint8_t numLanes = encoder::numLanes;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Constructor: Set the pins of all lanes to digital output
+	////////////////////////////////////////////////////////////////////////
+	avrBitbangLedLanes() { encoder::init(); };
+	////////////////////////////////////////////////////////////////////////
+	~avrBitbangLedLanes() { };
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Gamma correction and global brightness of the bytes sent,
+	/// see fabByteFilter
+	////////////////////////////////////////////////////////////////////////
+#ifdef FAB_BRIGHTNESS
+	using filter::brightness;
+	using filter::setBrightness;
+#endif
+	using filter::filterByte;
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends N bytes to the LED strips, see fabLaneEncoder.
+	/// @warning The caller must handle interupts!
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	sendBytes(const indexType count, const uint8_t * array)
+	{
+		encoder::sendBytes(count, array);
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends pixels in the LED strip native order
+	/// @param[in] numPixels Number of pixels of all the lanes together
+	/// @param[in] array     Array of pixels in the lanes layout
+	/// @note The typed overload only takes the native pixel type, for
+	/// example grb for ws2812bn: the lane encoder has no time to reorder.
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	sendPixels(const indexType numPixels, const uint8_t * array)
+	{
+		DISABLE_INTERRUPTS;
+		sendBytes(numPixels * bytesPerPixel, array);
+		RESTORE_INTERRUPTS;
+	}
+
+	template <class pixelType>
+	static inline void
+	sendPixels(const indexType numPixels, const pixelType * array)
+	{
+		STATIC_ASSERT(isNative<pixelType>::value,
+			Pixel_type_must_be_in_native_order);
+		sendPixels(numPixels, (const uint8_t *) array);
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Sends LED strips of different lengths, split layout only.
+	/// @param[in] counts Number of pixels of each lane
+	/// @param[in] array  Array of the pixel blocks of all lanes in a row
+	////////////////////////////////////////////////////////////////////////
+	static inline void
+	sendSegments(const indexType * counts, const uint8_t * array)
+	{
+		DISABLE_INTERRUPTS;
+		encoder::sendSegments(counts, array);
+		RESTORE_INTERRUPTS;
+	}
+
+	template <class pixelType>
+	static inline void
+	sendSegments(const indexType * counts, const pixelType * array)
+	{
+		STATIC_ASSERT(isNative<pixelType>::value,
+			Pixel_type_must_be_in_native_order);
+		sendSegments(counts, (const uint8_t *) array);
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Clears the LED strips
+	/// @param[in] numPixels  Number of pixels to erase, all lanes together
+	////////////////////////////////////////////////////////////////////////
+	static inline void clear(const indexType numPixels)
+	{
+		const uint8_t array[numLanes * bytesPerPixel] = {};
+
+		DISABLE_INTERRUPTS;
+		for (indexType i = 0; i < numPixels; i += numLanes) {
+			sendBytes(numLanes * bytesPerPixel, array);
+		}
+		RESTORE_INTERRUPTS;
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	/// @brief Waits long enough to trigger a LED strip reset
+	////////////////////////////////////////////////////////////////////////
+	static inline void refresh() {
+		delay(minMsRefresh);
+	}
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation classes for LED strip
+// Defines the actual LED timings
+// WS2811 2811B 2812B 2812S 2801 LEDs use similar protocols and timings
+////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812B (default, mainstream)
+////////////////////////////////////////////////////////////////////////////////
+#if 0
+// These are the less agressive bitbanging timings
+#define WS2812B_1H_CY CYCLES(650)  // 650ns-950ns _----------__
+#define WS2812B_1L_CY CYCLES(125)  // 250ns-550ns .    .    .
+#define WS2812B_0H_CY CYCLES(125)  // 250ns-550ns _-----_______
+#define WS2812B_0L_CY CYCLES(650)  // 650ns-950ns .    .    .
+#define WS2812B_MS_REFRESH 50      // 50,000ns Minimum sleep time to reset LED strip
+#define WS2812B_NS_RF 2000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#else
+// These are the more agressive bitbanging timings, note 0 and 1 have different durations
+#define WS2812B_1H_CY CYCLES(500)  // 6  7 10 _----------__
+#define WS2812B_1L_CY CYCLES(125)  // 2  2  4 .    .    .
+#define WS2812B_0H_CY CYCLES(125)  // 2  2  5 _-----_______
+#define WS2812B_0L_CY CYCLES(188)  // 2  2  7 .    .    .
+#define WS2812B_MS_REFRESH 20      // Minimum sleep time (low) to reset LED strip
+#define WS2812B_NS_RF 2000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#endif
+
+#define FAB_TVAR_WS2812B WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
+	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class ws2812b : public avrBitbangLedStrip<FAB_TVAR_WS2812B>
+{
+	public:
+	ws2812b() : avrBitbangLedStrip<FAB_TVAR_WS2812B>() {};
+	~ws2812b() {};
+};
+#undef FAB_TVAR_WS2812B
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812BS - Bitbang the pixels to two ports in parallel.
+// The pixel array is split in two. Each port displays a half.
+////////////////////////////////////////////////////////////////////////////////
+#define FAB_TVAR_WS2812BS WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
+	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId1, dataPortBit1, dataPortId2, dataPortBit2, GRB, TWO_PORT_SPLIT_BITBANG, indexType
+template<avrLedStripPort dataPortId1, uint8_t dataPortBit1,avrLedStripPort dataPortId2, uint8_t dataPortBit2, class indexType = uint16_t>
+class ws2812bs : public avrBitbangLedStrip<FAB_TVAR_WS2812BS>
+{
+	public:
+	ws2812bs() : avrBitbangLedStrip<FAB_TVAR_WS2812BS>() {};
+	~ws2812bs() {};
+};
+#undef FAB_TVAR_WS2812BS
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812B8S - Bitbang the pixels to eight ports in parallel.
+// The pixel array is split in 8. Each port displays a portion.
+////////////////////////////////////////////////////////////////////////////////
+#define FAB_TVAR_WS2812B8S WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
+	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId, dataPortBit1, dataPortId, dataPortBit2, GRB, EIGHT_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit1, uint8_t dataPortBit2, class indexType = uint16_t>
+class ws2812b8s : public avrBitbangLedStrip<FAB_TVAR_WS2812B8S>
+{
+	public:
+	ws2812b8s() : avrBitbangLedStrip<FAB_TVAR_WS2812B8S>() {};
+	~ws2812b8s() {};
+};
+#undef FAB_TVAR_WS2812B8S
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812BI - Bitbang the pixels to two ports in parallel.
+// The pixels array is interleaved. One port displays the odd pixels, while the
+// other portdisplays the even pixels.
+////////////////////////////////////////////////////////////////////////////////
+#define FAB_TVAR_WS2812BI WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
+	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId1, dataPortBit1, dataPortId2, dataPortBit2, GRB, TWO_PORT_INTLV_BITBANG, indexType
+template<avrLedStripPort dataPortId1, uint8_t dataPortBit1,avrLedStripPort dataPortId2, uint8_t dataPortBit2, class indexType = uint16_t>
+class ws2812bi : public avrBitbangLedStrip<FAB_TVAR_WS2812BI>
+{
+	public:
+	ws2812bi() : avrBitbangLedStrip<FAB_TVAR_WS2812BI>() {};
+	~ws2812bi() {};
+};
+#undef FAB_TVAR_WS2812BI
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812BN - Bitbang the pixels to up to 8 ports in parallel, on any pins.
+// The pixel array is split or interleaved across the lanes, see fabLane.
+////////////////////////////////////////////////////////////////////////////////
+#define FAB_TVAR_WS2812BN WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
+	WS2812B_0L_CY, WS2812B_MS_REFRESH, GRB, layout, FAB_LANES_TVAR, indexType
+template<laneLayout layout, class L0, class L1,
+	class L2 = fabNoLane, class L3 = fabNoLane, class L4 = fabNoLane,
+	class L5 = fabNoLane, class L6 = fabNoLane, class L7 = fabNoLane,
+	class indexType = uint16_t>
+class ws2812bn : public avrBitbangLedLanes<FAB_TVAR_WS2812BN>
+{
+	public:
+	ws2812bn() : avrBitbangLedLanes<FAB_TVAR_WS2812BN>() {};
+	~ws2812bn() {};
+};
+#undef FAB_TVAR_WS2812BN
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WS2812 (1st generation of LEDs)
+////////////////////////////////////////////////////////////////////////////////
+#define WS2812_1H_CY CYCLES(550)  // 500ns 550ns-850ns  _----------__
+#define WS2812_1L_CY CYCLES(200)  // 125ns 200ns-500ns  .    .    .
+#define WS2812_0H_CY CYCLES(200)  // 125ns 200ns-500ns  _-----_______
+#define WS2812_0L_CY CYCLES(550)  // 500ns 550ns-850ns  .    .    .
+#define WS2812_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
+#define WS2812_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_WS2812 WS2812_1H_CY, WS2812_1L_CY, WS2812_0H_CY, \
+	WS2812_0L_CY, WS2812_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class ws2812 : public avrBitbangLedStrip<FAB_TVAR_WS2812>
+{
+	public:
+	ws2812() : avrBitbangLedStrip<FAB_TVAR_WS2812>() {};
+	~ws2812() {};
+};
+#undef FAB_TVAR_WS2812
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APA104 (newer better defined timings)
+////////////////////////////////////////////////////////////////////////////////
+#define APA104_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
+#define APA104_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
+#define APA104_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
+#define APA104_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
+#define APA104_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
+#define APA104_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_APA104 APA104_1H_CY, APA104_1L_CY, APA104_0H_CY, \
+	APA104_0L_CY, APA104_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class apa104 : public avrBitbangLedStrip<FAB_TVAR_APA104>
+{
+	public:
+	apa104() : avrBitbangLedStrip<FAB_TVAR_APA104>() {};
+	~apa104() {};
+};
+#undef FAB_TVAR_APA104
+#define pl9823 apa104; 
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APA106 (like APA104, but with LEDs ordered as RGB instead of GRB)
+////////////////////////////////////////////////////////////////////////////////
+#define APA106_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
+#define APA106_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
+#define APA106_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
+#define APA106_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
+#define APA106_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
+#define APA106_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_APA106 APA106_1H_CY, APA106_1L_CY, APA106_0H_CY, \
+	APA106_0L_CY, APA106_MS_REFRESH, dataPortId, dataPortBit, A, 0, RGB, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class apa106 : public avrBitbangLedStrip<FAB_TVAR_APA106>
+{
+	public:
+	apa106() : avrBitbangLedStrip<FAB_TVAR_APA106>() {};
+	~apa106() {};
+};
+#undef FAB_TVAR_APA106
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SK6812 (4 color RGBW LEDs, faster PWM frequency, updated timings)
+/// @note I need to use microsleep to not round up sleep to 1msec.
+////////////////////////////////////////////////////////////////////////////////
+#define SK6812_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
+#define SK6812_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
+#define SK6812_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
+#define SK6812_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
+#define SK6812_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
+#define SK6812_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_SK6812 SK6812_1H_CY, SK6812_1L_CY, SK6812_0H_CY, \
+	SK6812_0L_CY, SK6812_MS_REFRESH, dataPortId, dataPortBit, A, 0, RGBW, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class sk6812 : public avrBitbangLedStrip<FAB_TVAR_SK6812>
+{
+	public:
+	sk6812() : avrBitbangLedStrip<FAB_TVAR_SK6812>() {};
+	~sk6812() {};
+};
+#undef FAB_TVAR_SK6812
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SK6812B (4 color GRBW LEDs, faster PWM frequency, updated timings)
+/// @note I need to use microsleep to not round up sleep to 1msec.
+////////////////////////////////////////////////////////////////////////////////
+#define SK6812B_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
+#define SK6812B_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
+#define SK6812B_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
+#define SK6812B_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
+#define SK6812B_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
+#define SK6812B_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_SK6812B SK6812B_1H_CY, SK6812B_1L_CY, SK6812B_0H_CY, \
+	SK6812B_0L_CY, SK6812B_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRBW, ONE_PORT_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, class indexType = uint16_t>
+class sk6812b : public avrBitbangLedStrip<FAB_TVAR_SK6812B>
+{
+	public:
+	sk6812b() : avrBitbangLedStrip<FAB_TVAR_SK6812B>() {};
+	~sk6812b() {};
+};
+#undef FAB_TVAR_SK6812B
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APA-102 (3 color RGB LEDs, SPI protocol)
+////////////////////////////////////////////////////////////////////////////////
+#define APA102_1H_CY CYCLES(0) // Unused
+#define APA102_1L_CY CYCLES(0)  // Unused
+#define APA102_0H_CY CYCLES(0)  // Unused
+#define APA102_0L_CY CYCLES(0) // Unused
+#define APA102_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
+#define APA102_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
+#define FAB_TVAR_APA102 APA102_1H_CY, APA102_1L_CY, APA102_0H_CY, \
+	APA102_0L_CY, APA102_MS_REFRESH, dataPortId, dataPortBit, clockPortId, clockPortBit, HBGR, SPI_BITBANG, indexType
+template<avrLedStripPort dataPortId, uint8_t dataPortBit, avrLedStripPort clockPortId, uint8_t clockPortBit, class indexType = uint16_t>
+class apa102 : public avrBitbangLedStrip<FAB_TVAR_APA102>
+{
+	public:
+	apa102() : avrBitbangLedStrip<FAB_TVAR_APA102>() {};
+	~apa102() {};
+};
+#undef FAB_TVAR_APA102
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APA-102X8 - Bitbang the pixels to up to 7 APA-102 LED strips in parallel.
+// The data lines are on pins firstDataBit to clockBit-1 of the port, and all
+// LED strips share the clock line on pin clockBit of the same port.
+// The pixel array is split in blocks. Each LED strip displays a block.
+// When the pixels of a send do not divide evenly, the first LED strips get
+// one more pixel, and the others get zero bytes after their last pixel.
+// These zero bytes are the start of their end frame, so only the last
+// sendPixels before refresh() may have such a remainder: make the other
+// sends of a frame a multiple of the number of LED strips.
+////////////////////////////////////////////////////////////////////////////////
+#define FAB_TVAR_APA102X8 APA102_1H_CY, APA102_1L_CY, APA102_0H_CY, \
+	APA102_0L_CY, APA102_MS_REFRESH, portId, firstDataBit, portId, clockBit, HBGR, SPI_PARALLEL_BITBANG, indexType
+template<avrLedStripPort portId, uint8_t firstDataBit, uint8_t clockBit, class indexType = uint16_t>
+class apa102x8 : public avrBitbangLedStrip<FAB_TVAR_APA102X8>
+{
+	public:
+	apa102x8() : avrBitbangLedStrip<FAB_TVAR_APA102X8>() {};
+	~apa102x8() {};
+};
+#undef FAB_TVAR_APA102X8
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Heterogeneous chain of LED strips spliced on one data line, for
+/// example RGB APA106 LEDs followed by GRB WS2812B and RGBW SK6812 LEDs.
+/// A fabSegment names the LED strip class of a run of LEDs, and the pixels
+/// to send to it. The pixel format conversion of each segment is resolved at
+/// compile time by the typed sendPixels() of its LED strip class.
+///
+/// sendChain() sends 2 to 4 segments in one pass with interrupts off, so
+/// no interrupt handler can stretch the low time between two segments. The
+/// nested sends of the segments keep them off. That low time is the setup
+/// of the next segment send and its first byte, inlined but neither
+/// bounded nor checked at compile time: measure a chain that mixes costly
+/// pixel conversions with the H_benchmark example.
+///
+/// Example:
+/// sendChain(fabSegment<ws2812b<D,6>, grbw>(16, &pixels[0]),
+///           fabSegment<sk6812<D,6>,  grbw>(32, &pixels[16]));
+////////////////////////////////////////////////////////////////////////////////
+template <class ledStrip, class pixelType>
+struct fabSegment {
+	typedef typename ledStrip::indexT indexType;
+
+	const indexType numPixels;
+	const pixelType * pixels;
+
+	fabSegment(const indexType count, const pixelType * array) :
+		numPixels(count), pixels(array) {};
+
+	inline void send() const __attribute__ ((always_inline)) {
+		ledStrip::sendPixels(numPixels, pixels);
 	}
+};
+
+template <class segment0, class segment1>
+static inline void
+sendChain(const segment0 & s0, const segment1 & s1)
+{
+	// Nested sendPixels() restore interrupts to the state saved here: off.
+	DISABLE_INTERRUPTS;
+	s0.send();
+	s1.send();
+	RESTORE_INTERRUPTS;
+}
+
+// Longer chains send their first segment, then delegate the others to the
+// chain one segment shorter, still with interrupts off.
+template <class segment0, class segment1, class segment2>
+static inline void
+sendChain(const segment0 & s0, const segment1 & s1, const segment2 & s2)
+{
+	DISABLE_INTERRUPTS;
+	s0.send();
+	sendChain(s1, s2);
+	RESTORE_INTERRUPTS;
+}
+
+template <class segment0, class segment1, class segment2, class segment3>
+static inline void
+sendChain(const segment0 & s0, const segment1 & s1, const segment2 & s2,
+		const segment3 & s3)
+{
+	DISABLE_INTERRUPTS;
+	s0.send();
+	sendChain(s1, s2, s3);
+	RESTORE_INTERRUPTS;
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::spiSoftwareSendFrame(const uint16_t count, bool high)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compressed palette animation, decoded frame by frame from a byte
+/// source: fabFlashSource for PROGMEM data, fabArraySource for RAM, or any
+/// struct with a uint8_t next() method reading an SD card or a serial line.
+/// The host tool extras/fabAnimEncode.py converts raw RGB frame dumps to
+/// this format.
+///
+/// Stream format, 16-bit values are little endian:
+///   'F' 'A' bits pixels(16) ms(16)  Header: bits per pixel, number of
+///                                   pixels and frame duration
+///   'P' first count r g b ...       Palette entries first to first+count-1,
+///                                   count 0 means 256
+///   'K' pixels ...                  Keyframe: the ARRAY_SIZE(pixels, bits)
+///                                   bytes of the packed pixel array
+///   'D' skip len bytes ... 0 0      Delta frame: runs of len changed bytes
+///                                   of the packed pixel array, each after
+///                                   skip unchanged bytes
+///   'E'                             End of the animation
+///
+/// The pixel array is packed like the 1, 2, 4 and 8-bit palette sendPixels()
+/// arrays, so show() streams it through the palette with no RGB frame
+/// buffer. The decoder state is the packed pixel array and the palette.
+///
+/// Example:
+/// const uint8_t movie[] PROGMEM = { ... };
+/// const fabFlashSource movieSource = {movie};
+/// fabAnimation<4, 64, fabFlashSource> anim(movieSource);
+/// ...
+/// if (!anim.nextFrame()) anim.rewind();
+/// anim.show(strip);
+/// delay(anim.frameMs);
+////////////////////////////////////////////////////////////////////////////////
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
+class fabAnimation {
+	public:
+	static const uint16_t arraySize = ARRAY_SIZE(numPixels, bitsPerPixel);
+	static const uint16_t numColors = 1 << bitsPerPixel;
+
+	uint8_t pixels[arraySize];  // Packed color indexes of the current frame
+	rgb palette[numColors];     // Palette of the current frame
+	uint16_t frameMs;           // Frame duration from the header
+	bool valid;                 // Header matches the template parameters
+
+	fabAnimation(const byteSource & source);
+
+	/// @brief Restarts the animation from its header, and clears the frame.
+	inline void rewind(void);
+
+	/// @brief Decodes the next frame and its palette changes.
+	/// @return false at the end of the animation or on a corrupt stream,
+	/// leaving the previous frame unchanged.
+	inline bool nextFrame(void);
+
+	/// @brief Sends the current frame to a LED strip.
+	template <class ledStrip>
+	inline void show(ledStrip & strip) const __attribute__ ((always_inline));
+
+	protected:
+	const byteSource start;
+	byteSource source;
+
+	inline uint16_t read16(void) __attribute__ ((always_inline));
+};
+
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
+fabAnimation<bitsPerPixel, numPixels, byteSource>::fabAnimation(
+		const byteSource & animation) :
+	start(animation)
 {
-	if (high) {
-		SET_PORT_HIGH(dataPortId, dataPortPin);
-	} else {
-		SET_PORT_LOW(dataPortId, dataPortPin);
-	}
-	// for(uint32_t c = 0; c < 32 * count; c++) {
-	for(uint32_t c = 0; c < 8 * count; c++) {
-		SET_PORT_LOW(clockPortId, clockPortPin);
-		SET_PORT_HIGH(clockPortId, clockPortPin);
-	}
+	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+		 bitsPerPixel == 4 || bitsPerPixel == 8,
+		Unsupported_palette_size);
+	rewind();
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::spiSoftwareSendBytes(const uint16_t count, const uint8_t * array)
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
+inline uint16_t
+fabAnimation<bitsPerPixel, numPixels, byteSource>::read16(void)
 {
-	for(uint16_t cnt = 0; cnt < count; ++cnt) {
-		const uint8_t val = array[cnt];
-		// If LED strip is defined as 3 byte type (default) then hard code the first
-		// byte to 0xFF, aka max brightness.
-		// This hard-codes the APA-102 protocol here so it is a bit hacky.
-		if (IS_PIXEL_FORMAT_4B(colors) && ((cnt % 3) == 0)) {
-//			spiSoftwareSendFrame(1, true);
-		}
-		// To send a bit to SPI, set its value, then transtion clock low-high
-		for(int8_t b=7; b>=0; b--) {
-			const bool bit = (val>>b) & 0x1;
-			SET_PORT_LOW(clockPortId, clockPortPin);
- 			if (bit) {
-				SET_PORT_HIGH(dataPortId, dataPortPin);
-			} else {
-				SET_PORT_LOW(dataPortId, dataPortPin);
-			}
-			SET_PORT_HIGH(clockPortId, clockPortPin);
-		}
-
-	}
+	const uint8_t low = source.next();
+	return low | (source.next() << 8);
 }
 
-/// @brief sends the array split across two ports each having half the LED strip to illuminate.
-/// To achieve this, we repurpose the clock port used for SPI as a second data port.
-/// We support two protocols:
-/// TWO_PORT_SPLIT_BITBANG: The array is split into 2 halves sent each sent to one of the ports
-/// TWO_PORT_INTLV_BITBANG: The array is interleaved and each pixel of 3 byte is sent to the next port
-template<FAB_TDEF>
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::twoPortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
+fabAnimation<bitsPerPixel, numPixels, byteSource>::rewind(void)
 {
-	// Number of bytes per pixel
-	const uint16_t bpp =  IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
-
-	// If split mode, we send a block of half size
-	const uint16_t blockSize = (protocol == TWO_PORT_SPLIT_BITBANG) ? count/2 : count;
-
-	// Stride is two for interlacing to jump pixels going to the other port
-	const uint8_t stride = (protocol == TWO_PORT_SPLIT_BITBANG) ? 1 : 2;
-	const uint8_t increment = stride * bpp;
-
-	// Loop to scan all pixels, potentially skipping every other pixel, or scanning 1/2 the pixels
-	// based on the display protocol used.
-	for(uint16_t pix = 0; pix < blockSize; pix += increment) {
-		// Loop to send 3 or 4 bytes of a pixel to the same port
-		for(uint16_t pos = pix; pos < pix+bpp; pos++) {
-			for(int8_t bit = 7; bit >= 0; bit--) {
-				const uint8_t mask = 1 << bit;
-
-				volatile bool isbitDhigh = array[pos] & mask;
-	
-				volatile bool isbitChigh = (protocol == TWO_PORT_SPLIT_BITBANG) ?
-					array[pos + blockSize] & mask : // split: pixel is blockSize away.
-					array[pos + bpp] & mask;        // interleaved: pixel is next one.
-
-				if (isbitDhigh) SET_PORT_HIGH(dataPortId, dataPortPin);
-				if (isbitChigh) SET_PORT_HIGH(clockPortId, clockPortPin);
-
-				if (!isbitDhigh) {
-					SET_PORT_HIGH(dataPortId, dataPortPin);
-					DELAY_CYCLES(high0 - sbiCycles);
-					SET_PORT_LOW(dataPortId, dataPortPin);
-				}
-				if (!isbitChigh) {
-					SET_PORT_HIGH(clockPortId, clockPortPin);
-					DELAY_CYCLES(high0 - sbiCycles);
-					SET_PORT_LOW(clockPortId, clockPortPin);
-				}
-				DELAY_CYCLES(high1 - 2*sbiCycles);
-				SET_PORT_LOW(dataPortId, dataPortPin);
-				SET_PORT_LOW(clockPortId, clockPortPin);
-				DELAY_CYCLES(low1 - 2*cbiCycles);
-			}
-		}
-	}
+	source = start;
+	memset(pixels, 0, sizeof(pixels));
+	memset(palette, 0, sizeof(palette));
+
+	valid = (source.next() == 'F');
+	valid &= (source.next() == 'A');
+	valid &= (source.next() == bitsPerPixel);
+	valid &= (read16() == numPixels);
+	frameMs = read16();
 }
 
-#if 0
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::twoPortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
+inline bool
+fabAnimation<bitsPerPixel, numPixels, byteSource>::nextFrame(void)
 {
-	const uint16_t blockSize = count/2;
-
-	for(uint16_t pos = 0; pos < blockSize; pos++) {
-		for(int8_t bit = 7; bit >= 0; bit--) {
-			const uint8_t mask = 1 << bit;
-			const bool isbitDhigh = array[0*blockSize + pos] & mask;
-			const bool isbitChigh = array[1*blockSize + pos] & mask;
-
-			if (isbitDhigh) SET_PORT_HIGH(dataPortId, dataPortPin);
-			if (isbitChigh) SET_PORT_HIGH(clockPortId, clockPortPin);
-
-			if (!isbitDhigh) {
-				SET_PORT_HIGH(dataPortId, dataPortPin);
-				//DELAY_CYCLES(high0 - sbiCycles);
-				DELAY_CYCLES(0);
-				SET_PORT_LOW(dataPortId, dataPortPin);
+	while (valid) {
+		switch (source.next()) {
+		case 'P': {
+			uint8_t first = source.next();
+			uint16_t count = source.next();
+			if (count == 0) count = 256;
+			if (first + count > numColors) break;
+			for (rgb * entry = &palette[first]; count > 0; count--) {
+				entry->r = source.next();
+				entry->g = source.next();
+				entry->b = source.next();
+				entry++;
 			}
-			if (!isbitChigh) {
-				SET_PORT_HIGH(clockPortId, clockPortPin);
-				//DELAY_CYCLES(high0 - sbiCycles);
-				DELAY_CYCLES(0);
-				SET_PORT_LOW(clockPortId, clockPortPin);
+			continue;
+		}
+		case 'K':
+			for (uint16_t i = 0; i < arraySize; i++) {
+				pixels[i] = source.next();
 			}
-			DELAY_CYCLES(0);
-			SET_PORT_LOW(dataPortId, dataPortPin);
-			SET_PORT_LOW(clockPortId, clockPortPin);
-			DELAY_CYCLES(0);
+			return true;
+		case 'D': {
+			uint16_t pos = 0;
+			while (1) {
+				const uint8_t skip = source.next();
+				uint8_t len = source.next();
+				if (skip == 0 && len == 0) {
+					return true;
+				}
+				pos += skip;
+				if (pos + len > arraySize) break;
+				for (; len > 0; len--) {
+					pixels[pos++] = source.next();
+				}
+			}
+			break;
+		}
+		case 'E':
+			return false;
 		}
+		// Unknown record or out of bounds data: stop the animation
+		valid = false;
 	}
+	return false;
 }
-#endif
-
 
-template<FAB_TDEF>
+template <uint8_t bitsPerPixel, uint16_t numPixels, class byteSource>
+template <class ledStrip>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::eightPortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
+fabAnimation<bitsPerPixel, numPixels, byteSource>::show(ledStrip & strip) const
 {
-	const uint16_t bpp =  IS_PIXEL_FORMAT_3B(colors) ? 3 : 4;
-	const uint16_t blockSize __asm__("r14") = count / (clockPortPin - dataPortPin + 1) / bpp * bpp;
+	strip.template sendPixels<bitsPerPixel>(numPixels, pixels, palette);
+}
 
-	// Buffer one byte of each port in register
-	uint8_t r0 = 0; // __asm__("r2") = 0;
-	uint8_t r1 = 0; // __asm__("r3") = 0;
-	uint8_t r2 = 0; // __asm__("r4") = 0;
-	uint8_t r3 = 0; // __asm__("r5") = 0;
-	uint8_t r4 = 0; // __asm__("r6") = 0;
-	uint8_t r5 = 0; // __asm__("r7") = 0;
-	uint8_t r6 = 0; // __asm__("r8") = 0;
-	uint8_t r7 = 0; // __asm__("r9") = 0;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Pixel buffer managed for partial refresh. A WS2812B chain keeps the
+/// color of the LEDs past the last pixel sent, so update() only sends the
+/// prefix of the buffer up to the highest pixel modified since the previous
+/// update. On a long strip where only the first pixels animate, the frame
+/// time drops in proportion.
+///
+/// Pixels modified through set() and at() are tracked. After writing to the
+/// pixels array directly, call touch() with the highest index written, or
+/// use updateAll(), which also restores LEDs that were glitched or powered
+/// on after the last full frame.
+///
+/// LED strips splitting the array in one block per lane, like ws2812bs,
+/// ws2812b8s and apa102x8, would spread a prefix over all their lanes, so
+/// only updateAll() compiles for them. Interleaved ones like ws2812bi keep
+/// every pixel on its lane and support update().
+///
+/// Example:
+/// fabPixelBuffer<ws2812b<D,6>, grb, 1000> frame;
+/// frame.set(3, color);
+/// frame.update(); // Sends pixels 0 to 3
+////////////////////////////////////////////////////////////////////////////////
+template <class ledStrip, class pixelType, uint16_t numPixels>
+class fabPixelBuffer {
+	public:
+	typedef typename ledStrip::indexT indexType;
 
-	// Since bits for each port are sent delayed by one cycle to
-	// implement the memory access pipeline, we must leave the
-	// ports not yet in use set to LOW level. Once the pipeline
-	// is initialized fully onMask == 0xFF, and we always set it
-	// to high to send a zero or a one.
-	uint8_t onMask __asm__("r10") = 0;
+	pixelType pixels[numPixels];
+	indexType dirty;  // Number of pixels to send at the next update()
 
-	for(uint16_t c __asm__("r12") = 0; c < blockSize ; ++c) {
-		for(int8_t b __asm__("r13") = 7; b >= 0; --b) {
-			uint8_t bitmask __asm__("r10") = 0;
+	fabPixelBuffer() : dirty(numPixels) {
+		memset(pixels, 0, sizeof(pixels));
+	};
 
-			// Load ONE byte per iteration
-			// Skip end condition check to reduce CPU cycles.
-			// It is expected that the LED strip won't have extra pixels.
-			switch (b) {
-				case 0:
-					// By checking statically if rX is read from memory, we
-					// avoid changing it, and the compiler will optimize out all
-					// the code including bitmask setting. On 16MHz Uno, we can
-					// only set bitmask for 6 ports before the strip resets.
-					if (0 == dataPortPin) {
-						onMask |= 1;
-						r0 = array[c];
-					}
+	/// @brief Marks pixels 0 to index to be sent at the next update().
+	inline void touch(const indexType index) __attribute__ ((always_inline));
 
-					if (r0 & 0b10000000) bitmask |= 1;
-					if (r1 & 0b01000000) bitmask |= 2;
-					if (r2 & 0b00100000) bitmask |= 4;
-					if (r3 & 0b00010000) bitmask |= 8;
-					if (r4 & 0b00001000) bitmask |= 16;
-					if (r5 & 0b00000100) bitmask |= 32;
-					if (r6 & 0b00000010) bitmask |= 64;
-					if (r7 & 0b00000001) bitmask |= 128;
-					break;
-				case 1:
-					if ((1 >= dataPortPin) && (1 <= clockPortPin)) {
-						onMask |= 2;
-						r1 = array[c + (1-dataPortPin) * blockSize];
-					}
+	/// @brief Sets a pixel and marks it to be sent.
+	inline void set(const indexType index, const pixelType & pixel)
+		__attribute__ ((always_inline));
 
-					if (r0 & 0b00000001) bitmask |= 1;
-					if (r1 & 0b10000000) bitmask |= 2;
-					if (r2 & 0b01000000) bitmask |= 4;
-					if (r3 & 0b00100000) bitmask |= 8;
-					if (r4 & 0b00010000) bitmask |= 16;
-					if (r5 & 0b00001000) bitmask |= 32;
-					if (r6 & 0b00000100) bitmask |= 64;
-					if (r7 & 0b00000010) bitmask |= 128;
-					break;
-				case 2:
-					if ((2 >= dataPortPin) && (2 <= clockPortPin)) {
-						onMask |= 4;
-						r2 = array[c + (2-dataPortPin) * blockSize];
-					}
+	/// @brief Returns a pixel for writing, marked to be sent.
+	inline pixelType & at(const indexType index) __attribute__ ((always_inline));
 
-					if (r0 & 0b00000010) bitmask |= 1;
-					if (r1 & 0b00000001) bitmask |= 2;
-					if (r2 & 0b10000000) bitmask |= 4;
-					if (r3 & 0b01000000) bitmask |= 8;
-					if (r4 & 0b00100000) bitmask |= 16;
-					if (r5 & 0b00010000) bitmask |= 32;
-					if (r6 & 0b00001000) bitmask |= 64;
-					if (r7 & 0b00000100) bitmask |= 128;
-					break;
-				case 3:
-					if ((3 >= dataPortPin) && (3 <= clockPortPin)) {
-						onMask |= 8;
-						r3 = array[c + (3-dataPortPin) * blockSize];
-					}
+	/// @brief Returns a pixel for reading.
+	inline const pixelType & get(const indexType index) const
+		__attribute__ ((always_inline));
 
-					if (r0 & 0b00000100) bitmask |= 1;
-					if (r1 & 0b00000010) bitmask |= 2;
-					if (r2 & 0b00000001) bitmask |= 4;
-					if (r3 & 0b10000000) bitmask |= 8;
-					if (r4 & 0b01000000) bitmask |= 16;
-					if (r5 & 0b00100000) bitmask |= 32;
-					if (r6 & 0b00010000) bitmask |= 64;
-					if (r7 & 0b00001000) bitmask |= 128;
-					break;
-				case 4:
-					if ((4 >= dataPortPin) && (4 <= clockPortPin)) {
-						onMask |= 16;
-						r4 = array[c + (4-dataPortPin) * blockSize];
-					}
+	/// @brief Sends the modified prefix of the buffer, if any. Not for
+	/// LED strips with split lanes, see splitLanes.
+	inline void update(void) __attribute__ ((always_inline));
 
-					if (r0 & 0b00001000) bitmask |= 1;
-					if (r1 & 0b00000100) bitmask |= 2;
-					if (r2 & 0b00000010) bitmask |= 4;
-					if (r3 & 0b00000001) bitmask |= 8;
-					if (r4 & 0b10000000) bitmask |= 16;
-					if (r5 & 0b01000000) bitmask |= 32;
-					if (r6 & 0b00100000) bitmask |= 64;
-					if (r7 & 0b00010000) bitmask |= 128;
-					break;
-				case 5:
-					if ((5 >= dataPortPin) && (5 <= clockPortPin)) {
-						onMask |= 32;
-						r5 = array[c + (5-dataPortPin) * blockSize];
-					}
+	/// @brief Sends the whole buffer.
+	inline void updateAll(void) __attribute__ ((always_inline));
+};
 
-					if (r0 & 0b00010000) bitmask |= 1;
-					if (r1 & 0b00001000) bitmask |= 2;
-					if (r2 & 0b00000100) bitmask |= 4;
-					if (r3 & 0b00000010) bitmask |= 8;
-					if (r4 & 0b00000001) bitmask |= 16;
-					if (r5 & 0b10000000) bitmask |= 32;
-					if (r6 & 0b01000000) bitmask |= 64;
-					if (r7 & 0b00100000) bitmask |= 128;
-					break;
-				case 6:
-					if ((6 >= dataPortPin) && (6 <= clockPortPin)) {
-						onMask |= 64;
-						r6 = array[c + (6-dataPortPin) * blockSize];
-					}
+template <class ledStrip, class pixelType, uint16_t numPixels>
+inline void
+fabPixelBuffer<ledStrip, pixelType, numPixels>::touch(const indexType index)
+{
+	if (index >= dirty) {
+		dirty = index + 1;
+	}
+}
 
-					if (r0 & 0b00100000) bitmask |= 1;
-					if (r1 & 0b00010000) bitmask |= 2;
-					if (r2 & 0b00001000) bitmask |= 4;
-					if (r3 & 0b00000100) bitmask |= 8;
-					if (r4 & 0b00000010) bitmask |= 16;
-					if (r5 & 0b00000001) bitmask |= 32;
-					if (r6 & 0b10000000) bitmask |= 64;
-					if (r7 & 0b01000000) bitmask |= 128;
-					break;
-				case 7:
-					if ((7 >= dataPortPin) && (7 <= clockPortPin)) {
-						onMask |= 128;
-						r7 = array[c + (7-dataPortPin) * blockSize];
-					}
+template <class ledStrip, class pixelType, uint16_t numPixels>
+inline void
+fabPixelBuffer<ledStrip, pixelType, numPixels>::set(
+		const indexType index,
+		const pixelType & pixel)
+{
+	pixels[index] = pixel;
+	touch(index);
+}
 
-					if (r0 & 0b01000000) bitmask |= 1;
-					if (r1 & 0b00100000) bitmask |= 2;
-					if (r2 & 0b00010000) bitmask |= 4;
-					if (r3 & 0b00001000) bitmask |= 8;
-					if (r4 & 0b00000100) bitmask |= 16;
-					if (r5 & 0b00000010) bitmask |= 32;
-					if (r6 & 0b00000001) bitmask |= 64;
-					if (r7 & 0b10000000) bitmask |= 128;
-					break;
-				}
+template <class ledStrip, class pixelType, uint16_t numPixels>
+inline pixelType &
+fabPixelBuffer<ledStrip, pixelType, numPixels>::at(const indexType index)
+{
+	touch(index);
+	return pixels[index];
+}
 
-			// Set all HIGH, set LOW all zeros, set LOW zeros and ones.
-			FAB_PORT(dataPortId, onMask);
-			DELAY_CYCLES(high0 - sbiCycles);
+template <class ledStrip, class pixelType, uint16_t numPixels>
+inline const pixelType &
+fabPixelBuffer<ledStrip, pixelType, numPixels>::get(const indexType index) const
+{
+	return pixels[index];
+}
 
-			FAB_PORT(dataPortId, bitmask);
-			DELAY_CYCLES( high1 - high0 + sbiCycles);
+template <class ledStrip, class pixelType, uint16_t numPixels>
+inline void
+fabPixelBuffer<ledStrip, pixelType, numPixels>::update(void)
+{
+	STATIC_ASSERT(!ledStrip::splitLanes,
+		Split_lane_LED_strips_only_support_updateAll);
 
-			FAB_PORT(dataPortId, 0x00);
-			// Estimate overhead of math above to ~ 20 cycles
-			DELAY_CYCLES(low0 - cbiCycles - 20);
-		}
+	if (dirty > 0) {
+		ledStrip::sendPixels(dirty, pixels);
+		dirty = 0;
 	}
 }
 
-
-template<FAB_TDEF>
+template <class ledStrip, class pixelType, uint16_t numPixels>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::onePortSoftwareSendBytes(const uint16_t count, const uint8_t * array)
+fabPixelBuffer<ledStrip, pixelType, numPixels>::updateAll(void)
 {
+	ledStrip::sendPixels(numPixels, pixels);
+	dirty = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Ring buffer view of a pixel array, to scroll an image in O(1) per
+/// frame: scroll() moves the base offset instead of copying the pixels, and
+/// send() walks the array from the base, wrapping around at its end, in one
+/// pass with interrupts off.
+///
+/// Logical pixel i, as sent on the LED strip, is pixels[(base + i) % length].
+/// scroll(1) moves the image one pixel toward the start of the strip. To
+/// feed a ticker, scroll then write the new pixel at(length - 1).
+///
+/// Example:
+/// grb pixels[64];
+/// fabRing<ws2812b<D,6>, grb> ring(64, pixels);
+/// ring.scroll(1);
+/// ring.send();
+////////////////////////////////////////////////////////////////////////////////
+template <class ledStrip, class pixelType>
+class fabRing {
+	public:
+	typedef typename ledStrip::indexT indexType;
 
-	for(uint16_t c=0; c < count; c++) {
-		const uint8_t val = array[c];
-		for(int8_t b=7; b>=0; b--) {
-			const bool bit = (val>>b) & 0x1;
- 
- 			if (bit) {
-				// Send a ONE
+	pixelType * const pixels;
+	const indexType length;
+	indexType base;
 
-				// HIGH with ASM sbi (2 words, 2 cycles)
-				SET_PORT_HIGH(dataPortId, dataPortPin);
-				// Wait exact number of cycles specified
-				DELAY_CYCLES(high1 - sbiCycles);
-				//  LOW with ASM cbi (2 words, 2 cycles)
-				SET_PORT_LOW(dataPortId, dataPortPin);
-				// Wait exact number of cycles specified
-				DELAY_CYCLES(low1 - cbiCycles);
-			} else {
-				// Send a ZERO
-
-				// HIGH with ASM sbi (2 words, 2 cycles)
-				SET_PORT_HIGH(dataPortId, dataPortPin);
-				// Wait exact number of cycles specified
-				DELAY_CYCLES(high0 - sbiCycles);
-				//  LOW with ASM cbi (2 words, 2 cycles)
-				SET_PORT_LOW(dataPortId, dataPortPin);
-				// Wait exact number of cycles specified
-				DELAY_CYCLES(low0 - cbiCycles);
-			}
-		}
-	}
-}
+	fabRing(const indexType count, pixelType * array) :
+		pixels(array), length(count), base(0) {};
 
+	/// @brief Moves the base by delta pixels, modulo length, if any.
+	inline void scroll(const int16_t delta) __attribute__ ((always_inline));
 
-template<FAB_TDEF>
+	/// @brief Returns logical pixel index, for index < length.
+	inline pixelType & at(const indexType index) __attribute__ ((always_inline));
+
+	/// @brief Sends the pixels from the base, wrapping around.
+	inline void send(void) const __attribute__ ((always_inline));
+};
+
+template <class ledStrip, class pixelType>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::clear(const uint16_t numPixels)
+fabRing<ledStrip, pixelType>::scroll(const int16_t delta)
 {
-	if (protocol == SPI_BITBANG) {
-		// SPI: Send start frame, Clean numPixels, and Reset LED strip
-		spiSoftwareSendFrame(1 + numPixels + (numPixels+1)/2, 0);
-	} else {
-		// 1-wire: Delay next pixels to cause a refresh
-		const uint8_t array[4] = {0,0,0,0};
-
- 		DISABLE_INTERRUPTS;
-		for( uint16_t i = 0; i < numPixels; i++) {
-			sendBytes(bytesPerPixel, array);
-		}
-		RESTORE_INTERRUPTS;
+	if (length == 0) {
+		return;
 	}
+	int32_t next = ((int32_t) base + delta) % (int32_t) length;
+	base = (next < 0) ? next + length : next;
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::grey(const uint16_t numPixels, const uint8_t value)
+template <class ledStrip, class pixelType>
+inline pixelType &
+fabRing<ledStrip, pixelType>::at(const indexType index)
 {
-	const uint8_t array[4] = {value, value, value, value};
-
-	DISABLE_INTERRUPTS;
-	for( uint16_t i = 0; i < numPixels; i++) {
-		sendBytes(bytesPerPixel, array);
-	}
-	RESTORE_INTERRUPTS;
+	const indexType head = length - base;
+	return (index < head) ? pixels[base + index] : pixels[index - head];
 }
 
-// 3B raw input array
-template<FAB_TDEF>
+template <class ledStrip, class pixelType>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const uint8_t * array)
+fabRing<ledStrip, pixelType>::send(void) const
 {
- 	DISABLE_INTERRUPTS;
-	sendBytes(numPixels * bytesPerPixel, array);
-	RESTORE_INTERRUPTS;
+	ledStrip::sendRing(pixels, length, 1, base, 0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Ring buffer view of a row-major width x height pixel matrix, with
+/// independent row and column bases: scrollRows() scrolls the image
+/// vertically and scrollColumns() horizontally, each in O(1), and send()
+/// walks every row with both wrap-arounds in one pass with interrupts off.
+///
+/// Logical pixel (x, y) is pixels[((rowBase + y) % height) * width +
+/// (columnBase + x) % width]. The matrix must be wired in row-major order,
+/// with all the rows in the same direction.
+///
+/// Example:
+/// rgb pixels[8*8];
+/// fabRing2D<ws2812b<D,6>, rgb> matrix(8, 8, pixels);
+/// matrix.scrollColumns(1);
+/// matrix.send();
+////////////////////////////////////////////////////////////////////////////////
+template <class ledStrip, class pixelType>
+class fabRing2D {
+	public:
+	typedef typename ledStrip::indexT indexType;
+
+	pixelType * const pixels;
+	const uint8_t width;
+	const uint8_t height;
+	uint8_t columnBase;
+	uint8_t rowBase;
 
-// Since colors is a constant, the switch case will convert to 4 sendBytes max.
-#define SEND_REMAPPED_PIXELS(color, numPixels, array) {            \
- 		DISABLE_INTERRUPTS;                                \
-		for (uint16_t i = 0; i < numPixels; i++) {         \
-			switch (colors) {                          \
-				case RGB:                          \
-					sendBytes(1, &array[i].r); \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].b); \
-					break;                     \
-				case GRB:                          \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].r); \
-					sendBytes(1, &array[i].b); \
-					break;                     \
-				case BGR:                          \
-					sendBytes(1, &array[i].b); \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].r); \
-					break;                     \
-				case RGBW:                         \
-					sendBytes(1, &array[i].r); \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].b); \
-					sendBytes(1, &((rgbw*)array)[i].w); \
-					break;                     \
-				case GRBW:                         \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].r); \
-					sendBytes(1, &array[i].b); \
-					sendBytes(1, &((grbw*)array)[i].w); \
-					break;                     \
-				case HBGR:                         \
-					sendBytes(1, &((hbgr*)array)[i].w); \
-					sendBytes(1, &array[i].b); \
-					sendBytes(1, &array[i].g); \
-					sendBytes(1, &array[i].r); \
-					break;                     \
-				default:                           \
-					break;                     \
-			}                                          \
-		}                                                  \
-		RESTORE_INTERRUPTS;                                \
-	}
+	fabRing2D(const uint8_t w, const uint8_t h, pixelType * array) :
+		pixels(array), width(w), height(h), columnBase(0), rowBase(0) {};
 
+	/// @brief Moves the row base by delta rows, modulo height, if any.
+	inline void scrollRows(const int8_t delta) __attribute__ ((always_inline));
 
-// 4B struct input arrays
-template<FAB_TDEF>
+	/// @brief Moves the column base by delta columns, modulo width, if any.
+	inline void scrollColumns(const int8_t delta) __attribute__ ((always_inline));
+
+	/// @brief Returns logical pixel (x, y), for x < width and y < height.
+	inline pixelType & at(const uint8_t x, const uint8_t y)
+		__attribute__ ((always_inline));
+
+	/// @brief Sends the rows from the row base, each from the column base.
+	inline void send(void) const __attribute__ ((always_inline));
+};
+
+template <class ledStrip, class pixelType>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const rgbw * array)
+fabRing2D<ledStrip, pixelType>::scrollRows(const int8_t delta)
 {
-	if (colors == RGBW || colors == NONE) {
-		// Native format, send as raw bytes
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else if (colors == RGB) {
-		// Output array is same order but 3B, send as 32bit, which will be converted
-		// because last byte will be dropped
-		sendPixels(numPixels, (const uint32_t *) array);
-	} else {
-		// Handle input array of different format than LED strip
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
+	if (height == 0) {
+		return;
 	}
+	int16_t next = ((int16_t) rowBase + delta) % (int16_t) height;
+	rowBase = (next < 0) ? next + height : next;
 }
 
-template<FAB_TDEF>
+template <class ledStrip, class pixelType>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const grbw * array)
+fabRing2D<ledStrip, pixelType>::scrollColumns(const int8_t delta)
 {
-	if (colors == GRBW || colors == NONE) {
-		// Native format, send as raw bytes
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else if (colors == GRB) {
-		// Output array is same order but 3B, send as 32bit, which will be converted
-		// because last byte will be dropped
-		sendPixels(numPixels, (const uint32_t *) array);
-	} else {
-		// Handle input array of different format than LED strip
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
+	if (width == 0) {
+		return;
 	}
+	int16_t next = ((int16_t) columnBase + delta) % (int16_t) width;
+	columnBase = (next < 0) ? next + width : next;
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const hbgr * array)
+template <class ledStrip, class pixelType>
+inline pixelType &
+fabRing2D<ledStrip, pixelType>::at(const uint8_t x, const uint8_t y)
 {
-	if (colors == HBGR || colors == NONE) {
-		// Native format, send as raw bytes
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else if (colors == BGR) {
-		// Output array is same order but 3B, send as 32bit, which will be converted
-		// because last byte will be dropped
-		sendPixels(numPixels, (const uint32_t *) array);
-	} else {
-		// Handle input array of different format than LED strip
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
-	}
+	const uint8_t col = (x < width - columnBase) ? columnBase + x :
+		x - (width - columnBase);
+	const uint8_t row = (y < height - rowBase) ? rowBase + y :
+		y - (height - rowBase);
+	return pixels[(indexType) row * width + col];
 }
 
-// 3B struct input arrays
-template<FAB_TDEF>
+template <class ledStrip, class pixelType>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const rgb * array)
+fabRing2D<ledStrip, pixelType>::send(void) const
 {
-	if (colors == RGB || colors == NONE) {
-		// Input array is native format. No conversion.
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else {
-		// 4B, or 3B pixel array with different byte order, must be converted.
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
-	}
+	ledStrip::sendRing(pixels, width, height, columnBase, rowBase);
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const grb * array)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief 2D pixel matrix of width x height pixels, with clipped drawing
+/// primitives, sent to a LED matrix through a LED strip class.
+///
+/// Pixels are stored row-major: pixel (x, y) is pixel y * width + x. The
+/// layout tells how the LED matrix is wired: MATRIX_ROWS when all the rows
+/// run in the same direction, MATRIX_SERPENTINE when every odd row runs
+/// backwards, in which case those rows are sent reversed, with no copy.
+///
+/// pixelType is either a pixel type such as grb or rgbw, or fabPacked<bits>
+/// to store 1, 2, 4 or 8-bit palette color indexes, packed like the palette
+/// sendPixels() arrays: an 8x8 matrix of 2-bit pixels takes 16 bytes. Packed
+/// primitives fill whole bytes at a time.
+///
+/// Coordinates are signed, and all the primitives clip to the matrix, so
+/// shapes may be drawn partly outside.
+///
+/// Example:
+/// fabMatrix<8, 8, fabPacked<2> > matrix;
+/// matrix.fillRect(-2, 1, 5, 3, 1);
+/// matrix.send(strip, palette);
+////////////////////////////////////////////////////////////////////////////////
+enum matrixLayout {
+	MATRIX_ROWS,
+	MATRIX_SERPENTINE
+};
+
+/// @brief Pixel type of a fabMatrix storing packed palette color indexes.
+template <uint8_t bitsPerPixel>
+struct fabPacked {
+	static const uint8_t bits = bitsPerPixel;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Clips rectangle (x, y, w, h) to a width x height matrix.
+/// @param[out] dx, dy  Columns and rows clipped left and above
+/// @return false if nothing is left to draw.
+////////////////////////////////////////////////////////////////////////////////
+static inline bool
+fabClip(const uint8_t width, const uint8_t height,
+		int16_t & x, int16_t & y, int16_t & w, int16_t & h,
+		int16_t & dx, int16_t & dy)
 {
-	if (colors == GRB || colors == NONE) {
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else {
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
-	}
+	dx = (x < 0) ? -x : 0;
+	dy = (y < 0) ? -y : 0;
+	x += dx;
+	y += dy;
+	w -= dx;
+	h -= dy;
+	if (x + w > width) w = width - x;
+	if (y + h > height) h = height - y;
+	return (w > 0) && (h > 0);
 }
 
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const bgr * array)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copies numBits bits of a packed pixel array to another, from bit
+/// srcBit of src to bit dstBit of dst, where bit 0 is the least significant
+/// bit of a byte. After the first partial byte, each destination byte is
+/// written at once from a 16-bit window of the source, instead of pixel
+/// by pixel.
+////////////////////////////////////////////////////////////////////////////////
+static inline void
+fabCopyBits(uint8_t * dst, uint8_t dstBit,
+		const uint8_t * src, uint8_t srcBit,
+		uint16_t numBits)
 {
-	if (colors == BGR || colors == NONE) {
-		sendPixels(numPixels, (const uint8_t *) array);
-	} else {
-		SEND_REMAPPED_PIXELS(colors, numPixels, array);
+	while (numBits > 0) {
+		const uint8_t n = (numBits < (uint8_t) (8 - dstBit)) ?
+			numBits : 8 - dstBit;
+		uint16_t window = src[0];
+		if (srcBit + n > 8) {
+			window |= src[1] << 8;
+		}
+		const uint8_t bits = ((1 << n) - 1) & (window >> srcBit);
+		const uint8_t mask = ((1 << n) - 1) << dstBit;
+		*dst = (*dst & ~mask) | (bits << dstBit);
+
+		numBits -= n;
+		srcBit += n;
+		src += srcBit >> 3;
+		srcBit &= 7;
+		dstBit += n;
+		dst += dstBit >> 3;
+		dstBit &= 7;
 	}
 }
 
-// 4B raw input array
-template<FAB_TDEF>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		const uint16_t numPixels,
-		const uint32_t * pixelArray)
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copies bits like fabCopyBits, except the pixels of color index
+/// key, which are transparent. The opaque pixels of each source byte are
+/// found at once, by folding the bits of each pixel of source xor key.
+////////////////////////////////////////////////////////////////////////////////
+template <uint8_t bitsPerPixel>
+static inline void
+fabCopyBitsKeyed(uint8_t * dst, uint8_t dstBit,
+		const uint8_t * src, uint8_t srcBit,
+		uint16_t numBits, const uint8_t key)
 {
- 	DISABLE_INTERRUPTS;
-
-	if IS_PIXEL_FORMAT_4B(colors) {
-		// 4 byte per pixel array, send all bytes.
-		sendBytes((const uint16_t) numPixels * bytesPerPixel, (const uint8_t *) pixelArray);
-	} else {
-		// 3 byte per pixel array, send 3 out of 4 bytes.
-		for (uint16_t i=0; i< numPixels; i++) {
-			uint8_t * bytes = (uint8_t *) & pixelArray[i];
-			// For LED strips using 3 bytes per color, drop a byte.
-			sendBytes(bytesPerPixel, bytes);
+	const uint8_t andMask = (1 << bitsPerPixel) - 1;
+	const uint8_t keys = (key & andMask) * (0xFF / andMask);
+
+	while (numBits > 0) {
+		const uint8_t n = (numBits < (uint8_t) (8 - dstBit)) ?
+			numBits : 8 - dstBit;
+		uint16_t window = src[0];
+		if (srcBit + n > 8) {
+			window |= src[1] << 8;
+		}
+		const uint8_t bits = window >> srcBit;
+
+		// Mask of the opaque pixels: any bit of the pixel differs from key
+		uint8_t opaque = bits ^ keys;
+		if (bitsPerPixel == 2) {
+			opaque = (opaque | (opaque >> 1)) & 0x55;
+			opaque *= 0x03;
+		} else if (bitsPerPixel == 4) {
+			opaque = (opaque | (opaque >> 1) | (opaque >> 2) |
+				(opaque >> 3)) & 0x11;
+			opaque *= 0x0F;
+		} else if (bitsPerPixel == 8) {
+			opaque = opaque ? 0xFF : 0x00;
 		}
-	}
 
-	RESTORE_INTERRUPTS;
+		const uint8_t mask = (((1 << n) - 1) & opaque) << dstBit;
+		*dst = (*dst & ~mask) | ((bits << dstBit) & mask);
+
+		numBits -= n;
+		srcBit += n;
+		src += srcBit >> 3;
+		srcBit &= 7;
+		dstBit += n;
+		dst += dstBit >> 3;
+		dstBit &= 7;
+	}
 }
 
-// Palette input arrays
-template<FAB_TDEF>
-template <const uint8_t bitsPerPixel, class T>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels (
-		const uint16_t count,
-		const uint8_t * pixelArray,
-		const uint8_t * reds,
-		const uint8_t * greens,
-		const uint8_t * blues)
-{
-	// Debug: Support simple palettes 2, 4, 16 or 256 colors
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Animated sprite: frames of width x height packed color indexes,
+/// each frame ARRAY_SIZE(width * height, bitsPerPixel) bytes long, with a
+/// transparent color index. A key above the palette size draws every pixel.
+///
+/// Drawn into a packed fabMatrix with draw(), the color indexes are those of
+/// the matrix palette. Streamed with fabMatrixSpriteLayer, the sprite uses
+/// its own palette of native order entries.
+///
+/// Example:
+/// const uint8_t invaderFrames[2 * ARRAY_SIZE(8 * 8, 2)] = { ... };
+/// fabSprite<2> invader = {8, 8, invaderFrames, invaderPalette, 0, 0};
+/// invader.frame ^= 1;
+/// matrix.draw(invader, x, y);
+////////////////////////////////////////////////////////////////////////////////
+template <uint8_t bitsPerPixel>
+struct fabSprite {
+	uint8_t width;
+	uint8_t height;
+	const uint8_t * frames;
+	const uint8_t * palette;
+	uint16_t key;
+	uint8_t frame;  // Frame drawn
+
+	inline uint16_t frameBytes() const {
+		return ARRAY_SIZE((uint16_t) width * height, bitsPerPixel);
+	}
 
-	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
-		 bitsPerPixel == 4 || bitsPerPixel == 8,
-		Unsupported_palette_size);
+	inline const uint8_t * bitmap() const {
+		return &frames[frame * frameBytes()];
+	}
+};
 
-	// 1,2 4 and 8 bit bitmasks. Note 3,5,6 don't make sense
-	// and 5bits is handled separately with uint16_t type.
-	const uint8_t andMask = (bitsPerPixel ==1) ? 0x01 :
-			(bitsPerPixel == 2) ? 0x03 :
-			(bitsPerPixel == 4) ? 0x0F :
-			(bitsPerPixel == 8) ? 0xFF :
-			0x00;
+template <uint8_t width, uint8_t height, class pixelType,
+	matrixLayout layout = MATRIX_ROWS>
+class fabMatrix {
+	public:
+	typedef pixelType colorType;
+	static const uint16_t numPixels = (uint16_t) width * height;
 
- 	DISABLE_INTERRUPTS;
+	pixelType pixels[numPixels];
 
-	// Send each byte as 1 to 4 pixels
-	uint16_t offset;
-	offset = 0;
-	uint16_t index;
-	index = 0;
-	while (1) {
-		uint8_t elem; 
-		elem = pixelArray[offset++]; 
-		for (uint8_t j = 0; j < 8/bitsPerPixel; j++) {
-			if (index++ >= count) {
-				goto end;
-			}
-			const uint8_t colorIndex = elem & andMask;
-			T pixel;
-			pixel.r = reds[colorIndex];
-			pixel.g = greens[colorIndex];
-			pixel.b = blues[colorIndex];
-			// @note support w in future
-			sendPixels(1, &pixel);
-			elem >>= bitsPerPixel;
-		}
-	}
-end:
-	RESTORE_INTERRUPTS;
-}
+	fabMatrix() {
+		memset(pixels, 0, sizeof(pixels));
+	};
 
-// Palette input arrays
-template<FAB_TDEF>
-template <const uint8_t bitsPerPixel>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels (
-		const uint16_t count,
-		const uint8_t * pixelArray,
-		const uint8_t * palette)
-{
-	// Debug: Support simple palettes 2, 4, 16 or 256 colors
-	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
-		 bitsPerPixel == 4 || bitsPerPixel == 8,
-		Unsupported_palette_size);
+	/// @brief Sets pixel (x, y), if inside the matrix.
+	inline void set(const int16_t x, const int16_t y, const colorType color)
+		__attribute__ ((always_inline));
 
-	// 1,2 4 and 8 bit bitmasks. Note 3,5,6 don't make sense
-	// and 5bits is handled separately with uint16_t type.
-	const uint8_t andMask = (bitsPerPixel ==1) ? 0x01 :
-			(bitsPerPixel == 2) ? 0x03 :
-			(bitsPerPixel == 4) ? 0x0F :
-			(bitsPerPixel == 8) ? 0xFF :
-			0x00;
+	/// @brief Returns pixel (x, y), for a pixel inside the matrix.
+	inline colorType get(const uint8_t x, const uint8_t y) const
+		__attribute__ ((always_inline));
 
- 	DISABLE_INTERRUPTS;
+	/// @brief Draws a horizontal line of w pixels from (x, y) to the right.
+	inline void hline(int16_t x, int16_t y, int16_t w, const colorType color);
 
-	// Send each byte as 1 to 4 pixels
-	uint16_t offset;
-	offset = 0;
-	uint16_t index;
-	index = 0;
-	while (1) {
-		uint8_t elem; 
-		elem = pixelArray[offset++]; 
-		for (uint8_t j = 0; j < 8/bitsPerPixel; j++) {
-			if (index++ >= count) {
-				goto end;
-			}
-			const uint8_t colorIndex = elem & andMask;
-			sendBytes(bytesPerPixel, &palette[bytesPerPixel*colorIndex]);
-			elem >>= bitsPerPixel;
-		}
-	}
-end:
-	RESTORE_INTERRUPTS;
-}
+	/// @brief Draws a vertical line of h pixels from (x, y) down.
+	inline void vline(int16_t x, int16_t y, int16_t h, const colorType color);
 
-template<FAB_TDEF>
-template <const uint8_t bitsPerPixel, class T>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels (
-		const uint16_t count,
-		const uint8_t * pixelArray,
-		const T * palette)
-{
-	// Debug: Support simple palettes 2, 4, 16 or 256 colors
-	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
-		bitsPerPixel == 4 || bitsPerPixel == 8,
-		Unsupported_palette_size);
+	/// @brief Fills a rectangle of w x h pixels from (x, y).
+	inline void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+		const colorType color);
 
-	// 1,2 4 and 8 bit bitmasks. Note 3,5,6 don't make sense
-	// and 5bits is handled separately with uint16_t type.
-	const uint8_t andMask = (bitsPerPixel ==1) ? 0x01 :
-			(bitsPerPixel == 2) ? 0x03 :
-			(bitsPerPixel == 4) ? 0x0F :
-			(bitsPerPixel == 8) ? 0xFF :
-			0x00;
+	/// @brief Fills the whole matrix.
+	inline void fill(const colorType color);
 
- 	DISABLE_INTERRUPTS;
+	/// @brief Copies a row-major image of w x h pixels at (x, y).
+	inline void blit(int16_t x, int16_t y, int16_t w, int16_t h,
+		const pixelType * image);
 
-	// Send each byte as 1 to 4 pixels
-	uint16_t offset;
-	offset = 0;
-	uint16_t index;
-	index = 0;
-	while (1) {
-		uint8_t elem; 
-		elem = pixelArray[offset++]; 
-		for (uint8_t j = 0; j < 8/bitsPerPixel; j++) {
-			if (index++ >= count) {
-				goto end;
-			}
-			const uint8_t colorIndex = elem & andMask;
-			sendBytes(bytesPerPixel, &palette[bytesPerPixel*colorIndex]);
-			elem >>= bitsPerPixel;
-		}
+	/// @brief Sends the matrix to a LED strip, in its wiring order.
+	template <class ledStrip>
+	inline void send(ledStrip & strip) const;
+};
+
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+inline void
+fabMatrix<width, height, pixelType, layout>::set(
+		const int16_t x,
+		const int16_t y,
+		const colorType color)
+{
+	if ((uint16_t) x < width && (uint16_t) y < height) {
+		pixels[(uint16_t) y * width + x] = color;
 	}
-end:
-	RESTORE_INTERRUPTS;
 }
 
-template<FAB_TDEF>
-template <class pixelType> 
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap(
-		const uint16_t numPixels,
-		const uint16_t * pixelMap,
-		const pixelType * array)
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+inline typename fabMatrix<width, height, pixelType, layout>::colorType
+fabMatrix<width, height, pixelType, layout>::get(
+		const uint8_t x,
+		const uint8_t y) const
 {
-	// The uint8_t raw type actually does not hold the whole pixel, it needs 3 bytes.
-	const uint16_t size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
+	return pixels[(uint16_t) y * width + x];
+}
 
- 	DISABLE_INTERRUPTS;
-	for (uint16_t i = 0; i < numPixels; i += 1) {
-		const uint16_t ri = pixelMap[i];
-		sendPixels((uint16_t) 1, &array[size * ri]);
-	}
-	RESTORE_INTERRUPTS;
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+inline void
+fabMatrix<width, height, pixelType, layout>::hline(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		const colorType color)
+{
+	fillRect(x, y, w, 1, color);
 }
 
-// @note The 8bit per pixel works but 2bits per pixel does not at 16MHz.
-template<FAB_TDEF>
-template <const uint8_t bitsPerPixel, class pixelType>
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap (
-		const uint16_t numPixels,
-		const uint16_t * pixelMap,
-		const uint8_t * pixelArray,
-		const pixelType * palette)
+fabMatrix<width, height, pixelType, layout>::vline(
+		int16_t x,
+		int16_t y,
+		int16_t h,
+		const colorType color)
 {
-	// Support only palettes with 2, 4, 16 or 256 colors
-	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
-		bitsPerPixel == 4 || bitsPerPixel == 8,
-		Unsupported_palette_size);
+	fillRect(x, y, 1, h, color);
+}
 
-	const uint16_t size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+inline void
+fabMatrix<width, height, pixelType, layout>::fillRect(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		int16_t h,
+		const colorType color)
+{
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	pixelType * row = &pixels[(uint16_t) y * width + x];
+	for (; h > 0; h--) {
+		for (int16_t i = 0; i < w; i++) {
+			row[i] = color;
+		}
+		row += width;
+	}
+}
 
- 	DISABLE_INTERRUPTS;
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+inline void
+fabMatrix<width, height, pixelType, layout>::fill(const colorType color)
+{
 	for (uint16_t i = 0; i < numPixels; i++) {
-		// Remapped i: index in array of the next pixel to push.
-		const uint16_t ri = pixelMap[i];
-		// Extract color index via bitmasks
-		const uint8_t colorIndex = GET_PIXEL(pixelArray, ri, bitsPerPixel);
-		// Get the color/pixel to send
-		const pixelType * pixel =  &palette[size * colorIndex];
-		sendPixels(1, pixel);
+		pixels[i] = color;
 	}
-	RESTORE_INTERRUPTS;
 }
 
-
-template<FAB_TDEF>
-template <const uint8_t bitsPerPixel, class pixelType>
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
 inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixelsRemap (
-		const uint8_t numPixels,
-		const uint8_t * pixelMap,
-		const uint8_t * pixelArray,
-		const pixelType * palette)
+fabMatrix<width, height, pixelType, layout>::blit(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		int16_t h,
+		const pixelType * image)
 {
-	// Support only palettes with 2, 4, 16 or 256 colors
-	STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
-		bitsPerPixel == 4 || bitsPerPixel == 8,
-		Unsupported_palette_size);
-
-	const uint16_t size = (sizeof(pixelType) == 1) ? bytesPerPixel : 1;
-
- 	DISABLE_INTERRUPTS;
-	for (uint8_t i = 0; i < numPixels; i++) {
-		// Remapped i: index in array of the next pixel to push.
-		const uint8_t ri = pixelMap[i];
-		// Extract color index via bitmasks
-		const uint8_t colorIndex = GET_PIXEL(pixelArray, ri, bitsPerPixel);
-		// Get the color/pixel to send
-		const pixelType * pixel =  &palette[size * colorIndex];
-		sendPixels(1, pixel);
+	const int16_t stride = w;
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	pixelType * row = &pixels[(uint16_t) y * width + x];
+	image += dy * stride + dx;
+	for (; h > 0; h--) {
+		memcpy(row, image, w * sizeof(pixelType));
+		row += width;
+		image += stride;
+	}
+}
+
+template <uint8_t width, uint8_t height, class pixelType, matrixLayout layout>
+template <class ledStrip>
+inline void
+fabMatrix<width, height, pixelType, layout>::send(ledStrip & strip) const
+{
+	if (layout == MATRIX_ROWS) {
+		strip.sendPixels(numPixels, pixels);
+		return;
+	}
+
+	// Nested sends restore interrupts to the state saved here: off.
+	DISABLE_INTERRUPTS;
+	const pixelType * row = pixels;
+	for (uint8_t y = 0; y < height; y++) {
+		if (y & 1) {
+			strip.sendPixelsReversed(width, row);
+		} else {
+			strip.sendPixels(width, row);
+		}
+		row += width;
 	}
 	RESTORE_INTERRUPTS;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief fabMatrix of packed palette color indexes. Colors are palette
+/// color indexes, sent through a palette of native order entries.
+////////////////////////////////////////////////////////////////////////////////
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel,
+	matrixLayout layout>
+class fabMatrix<width, height, fabPacked<bitsPerPixel>, layout> {
+	public:
+	typedef uint8_t colorType;
+	static const uint16_t numPixels = (uint16_t) width * height;
+	static const uint8_t perByte = 8 / bitsPerPixel;
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
 
-/// @todo Rewrite this to support R5G6B5, R4G4B4W4 and a variable brightness.
-template<FAB_TDEF>
-template <uint8_t brightness>
-inline void
-avrBitbangLedStrip<FAB_TVAR>::sendPixels(
-		int count,
-		uint16_t * pixelArray)
-{
-	const uint8_t mask5 = ((1 << (5 - brightness))-1) || ((1 << brightness) - 1);
-	const uint8_t mask10 = ((1 << (10 - brightness))-1) || ((1 << brightness) - 1);
-	uint8_t bytes[4];
+	uint8_t pixels[ARRAY_SIZE(numPixels, bitsPerPixel)];
 
-	// Debug: Support brightness 0..3
-	STATIC_ASSERT(brightness < 3, Unsupported_brightness_level);
+	fabMatrix() {
+		STATIC_ASSERT( bitsPerPixel == 1 || bitsPerPixel == 2 ||
+			 bitsPerPixel == 4 || bitsPerPixel == 8,
+			Unsupported_palette_size);
+		memset(pixels, 0, sizeof(pixels));
+	};
 
- 	DISABLE_INTERRUPTS;
+	inline void set(const int16_t x, const int16_t y, const colorType color)
+		__attribute__ ((always_inline));
 
-	bytes[3] = 0;
-	for (int i = 0; i < count; i++) {
-		const uint16_t elem = pixelArray[i]; 
-		bytes[0] = (uint8_t) elem << brightness;
-		bytes[1] = (elem >> (5 - brightness)) & mask5;
-		bytes[2] = (elem >> (10 - brightness)) & mask10;
-		sendBytes(bytesPerPixel, bytes);
-	}
+	inline colorType get(const uint8_t x, const uint8_t y) const
+		__attribute__ ((always_inline));
 
-	RESTORE_INTERRUPTS;
-}
+	inline void hline(int16_t x, int16_t y, int16_t w, const colorType color);
 
+	inline void vline(int16_t x, int16_t y, int16_t h, const colorType color);
 
+	inline void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+		const colorType color);
 
-////////////////////////////////////////////////////////////////////////////////
-// Implementation classes for LED strip
-// Defines the actual LED timings
-// WS2811 2811B 2812B 2812S 2801 LEDs use similar protocols and timings
-////////////////////////////////////////////////////////////////////////////////
+	inline void fill(const colorType color);
 
+	/// @brief Copies a packed image of w x h pixels at (x, y), row by row
+	/// with fabCopyBits.
+	inline void blit(int16_t x, int16_t y, int16_t w, int16_t h,
+		const uint8_t * image);
 
-////////////////////////////////////////////////////////////////////////////////
-// WS2812B (default, mainstream)
-////////////////////////////////////////////////////////////////////////////////
-#if 0
-// These are the less agressive bitbanging timings
-#define WS2812B_1H_CY CYCLES(650)  // 650ns-950ns _----------__
-#define WS2812B_1L_CY CYCLES(125)  // 250ns-550ns .    .    .
-#define WS2812B_0H_CY CYCLES(125)  // 250ns-550ns _-----_______
-#define WS2812B_0L_CY CYCLES(650)  // 650ns-950ns .    .    .
-#define WS2812B_MS_REFRESH 50      // 50,000ns Minimum sleep time to reset LED strip
-#define WS2812B_NS_RF 2000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#else
-// These are the more agressive bitbanging timings, note 0 and 1 have different durations
-#define WS2812B_1H_CY CYCLES(500)  // 6  7 10 _----------__
-#define WS2812B_1L_CY CYCLES(125)  // 2  2  4 .    .    .
-#define WS2812B_0H_CY CYCLES(125)  // 2  2  5 _-----_______
-#define WS2812B_0L_CY CYCLES(188)  // 2  2  7 .    .    .
-#define WS2812B_MS_REFRESH 20      // Minimum sleep time (low) to reset LED strip
-#define WS2812B_NS_RF 2000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#endif
+	/// @brief Draws the current frame of a sprite at (x, y), skipping its
+	/// transparent pixels, row by row with fabCopyBitsKeyed.
+	inline void draw(const fabSprite<bitsPerPixel> & sprite,
+		int16_t x, int16_t y);
 
-#define FAB_TVAR_WS2812B WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
-	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class ws2812b : public avrBitbangLedStrip<FAB_TVAR_WS2812B>
-{
-	public:
-	ws2812b() : avrBitbangLedStrip<FAB_TVAR_WS2812B>() {};
-	~ws2812b() {};
-};
-#undef FAB_TVAR_WS2812B
+	/// @brief Sends the matrix to a LED strip through a palette of
+	/// 2^bitsPerPixel entries in the LED strip native order.
+	template <class ledStrip>
+	inline void send(ledStrip & strip, const uint8_t * palette,
+		const uint8_t rotate = 0) const;
 
+	protected:
+	/// @brief Color index repeated in a whole byte.
+	static inline uint8_t pattern(const colorType color)
+		__attribute__ ((always_inline));
 
-////////////////////////////////////////////////////////////////////////////////
-// WS2812BS - Bitbang the pixels to two ports in parallel.
-// The pixel array is split in two. Each port displays a half.
-////////////////////////////////////////////////////////////////////////////////
-#define FAB_TVAR_WS2812BS WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
-	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId1, dataPortBit1, dataPortId2, dataPortBit2, GRB, TWO_PORT_SPLIT_BITBANG
-template<avrLedStripPort dataPortId1, uint8_t dataPortBit1,avrLedStripPort dataPortId2, uint8_t dataPortBit2>
-class ws2812bs : public avrBitbangLedStrip<FAB_TVAR_WS2812BS>
-{
-	public:
-	ws2812bs() : avrBitbangLedStrip<FAB_TVAR_WS2812BS>() {};
-	~ws2812bs() {};
+	/// @brief Sets count pixels from pixel first, a byte at a time.
+	inline void fillSpan(uint16_t first, uint16_t count, const colorType color);
 };
-#undef FAB_TVAR_WS2812BS
 
-////////////////////////////////////////////////////////////////////////////////
-// WS2812B8S - Bitbang the pixels to eight ports in parallel.
-// The pixel array is split in 8. Each port displays a portion.
-////////////////////////////////////////////////////////////////////////////////
-#define FAB_TVAR_WS2812B8S WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
-	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId, dataPortBit1, dataPortId, dataPortBit2, GRB, EIGHT_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit1, uint8_t dataPortBit2>
-class ws2812b8s : public avrBitbangLedStrip<FAB_TVAR_WS2812B8S>
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline uint8_t
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::pattern(
+		const colorType color)
 {
-	public:
-	ws2812b8s() : avrBitbangLedStrip<FAB_TVAR_WS2812B8S>() {};
-	~ws2812b8s() {};
-};
-#undef FAB_TVAR_WS2812B8S
-
+	return (bitsPerPixel == 1) ? ((color & 1) ? 0xFF : 0x00) :
+		(bitsPerPixel == 2) ? (color & andMask) * 0x55 :
+		(bitsPerPixel == 4) ? (color & andMask) * 0x11 :
+		color;
+}
 
-////////////////////////////////////////////////////////////////////////////////
-// WS2812BI - Bitbang the pixels to two ports in parallel.
-// The pixels array is interleaved. One port displays the odd pixels, while the
-// other portdisplays the even pixels.
-////////////////////////////////////////////////////////////////////////////////
-#define FAB_TVAR_WS2812BI WS2812B_1H_CY, WS2812B_1L_CY, WS2812B_0H_CY, \
-	WS2812B_0L_CY, WS2812B_MS_REFRESH, dataPortId1, dataPortBit1, dataPortId2, dataPortBit2, GRB, TWO_PORT_INTLV_BITBANG
-template<avrLedStripPort dataPortId1, uint8_t dataPortBit1,avrLedStripPort dataPortId2, uint8_t dataPortBit2>
-class ws2812bi : public avrBitbangLedStrip<FAB_TVAR_WS2812BI>
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::set(
+		const int16_t x,
+		const int16_t y,
+		const colorType color)
 {
-	public:
-	ws2812bi() : avrBitbangLedStrip<FAB_TVAR_WS2812BI>() {};
-	~ws2812bi() {};
-};
-#undef FAB_TVAR_WS2812BI
+	if ((uint16_t) x < width && (uint16_t) y < height) {
+		const uint16_t index = (uint16_t) y * width + x;
+		const uint8_t shift = (index % perByte) * bitsPerPixel;
+		uint8_t & elem = pixels[index / perByte];
+		elem = (elem & ~(andMask << shift)) | ((color & andMask) << shift);
+	}
+}
 
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline uint8_t
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::get(
+		const uint8_t x,
+		const uint8_t y) const
+{
+	const uint16_t index = (uint16_t) y * width + x;
+	return (pixels[index / perByte] >> ((index % perByte) * bitsPerPixel))
+		& andMask;
+}
 
-////////////////////////////////////////////////////////////////////////////////
-// WS2812 (1st generation of LEDs)
-////////////////////////////////////////////////////////////////////////////////
-#define WS2812_1H_CY CYCLES(550)  // 500ns 550ns-850ns  _----------__
-#define WS2812_1L_CY CYCLES(200)  // 125ns 200ns-500ns  .    .    .
-#define WS2812_0H_CY CYCLES(200)  // 125ns 200ns-500ns  _-----_______
-#define WS2812_0L_CY CYCLES(550)  // 500ns 550ns-850ns  .    .    .
-#define WS2812_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
-#define WS2812_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_WS2812 WS2812_1H_CY, WS2812_1L_CY, WS2812_0H_CY, \
-	WS2812_0L_CY, WS2812_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class ws2812 : public avrBitbangLedStrip<FAB_TVAR_WS2812>
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::fillSpan(
+		uint16_t first,
+		uint16_t count,
+		const colorType color)
 {
-	public:
-	ws2812() : avrBitbangLedStrip<FAB_TVAR_WS2812>() {};
-	~ws2812() {};
-};
-#undef FAB_TVAR_WS2812
+	const uint8_t value = pattern(color);
+	uint8_t * elem = &pixels[first / perByte];
+	const uint8_t head = first % perByte;
+
+	// Partial first byte
+	if (head != 0) {
+		const uint8_t n = (count < (uint8_t) (perByte - head)) ?
+			count : perByte - head;
+		const uint8_t mask = ((1 << (n * bitsPerPixel)) - 1) <<
+			(head * bitsPerPixel);
+		*elem = (*elem & ~mask) | (value & mask);
+		elem++;
+		count -= n;
+	}
 
+	// Whole bytes
+	const uint16_t bytes = count / perByte;
+	memset(elem, value, bytes);
+	elem += bytes;
+	count -= bytes * perByte;
 
-////////////////////////////////////////////////////////////////////////////////
-// APA104 (newer better defined timings)
-////////////////////////////////////////////////////////////////////////////////
-#define APA104_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
-#define APA104_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
-#define APA104_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
-#define APA104_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
-#define APA104_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
-#define APA104_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_APA104 APA104_1H_CY, APA104_1L_CY, APA104_0H_CY, \
-	APA104_0L_CY, APA104_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRB, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class apa104 : public avrBitbangLedStrip<FAB_TVAR_APA104>
+	// Partial last byte
+	if (count != 0) {
+		const uint8_t mask = (1 << (count * bitsPerPixel)) - 1;
+		*elem = (*elem & ~mask) | (value & mask);
+	}
+}
+
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::hline(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		const colorType color)
 {
-	public:
-	apa104() : avrBitbangLedStrip<FAB_TVAR_APA104>() {};
-	~apa104() {};
-};
-#undef FAB_TVAR_APA104
-#define pl9823 apa104; 
+	fillRect(x, y, w, 1, color);
+}
 
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::vline(
+		int16_t x,
+		int16_t y,
+		int16_t h,
+		const colorType color)
+{
+	int16_t w = 1;
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	for (; h > 0; h--) {
+		set(x, y++, color);
+	}
+}
 
-////////////////////////////////////////////////////////////////////////////////
-// APA106 (like APA104, but with LEDs ordered as RGB instead of GRB)
-////////////////////////////////////////////////////////////////////////////////
-#define APA106_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
-#define APA106_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
-#define APA106_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
-#define APA106_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
-#define APA106_MS_REFRESH 50      //  50,000ns Minimum wait time to reset LED strip
-#define APA106_NS_RF 5000000      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_APA106 APA106_1H_CY, APA106_1L_CY, APA106_0H_CY, \
-	APA106_0L_CY, APA106_MS_REFRESH, dataPortId, dataPortBit, A, 0, RGB, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class apa106 : public avrBitbangLedStrip<FAB_TVAR_APA106>
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::fillRect(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		int16_t h,
+		const colorType color)
 {
-	public:
-	apa106() : avrBitbangLedStrip<FAB_TVAR_APA106>() {};
-	~apa106() {};
-};
-#undef FAB_TVAR_APA106
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	uint16_t first = (uint16_t) y * width + x;
+	if (w == width) {
+		// Full rows are contiguous
+		fillSpan(first, (uint16_t) h * width, color);
+		return;
+	}
+	for (; h > 0; h--) {
+		fillSpan(first, w, color);
+		first += width;
+	}
+}
 
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::fill(
+		const colorType color)
+{
+	memset(pixels, pattern(color), sizeof(pixels));
+}
 
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::blit(
+		int16_t x,
+		int16_t y,
+		int16_t w,
+		int16_t h,
+		const uint8_t * image)
+{
+	const int16_t stride = w;
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	uint16_t to = (uint16_t) y * width + x;
+	uint16_t from = (uint16_t) dy * stride + dx;
+	for (; h > 0; h--) {
+		fabCopyBits(&pixels[to / perByte], (to % perByte) * bitsPerPixel,
+			&image[from / perByte], (from % perByte) * bitsPerPixel,
+			(uint16_t) w * bitsPerPixel);
+		to += width;
+		from += stride;
+	}
+}
 
-////////////////////////////////////////////////////////////////////////////////
-// SK6812 (4 color RGBW LEDs, faster PWM frequency, updated timings)
-/// @note I need to use microsleep to not round up sleep to 1msec.
-////////////////////////////////////////////////////////////////////////////////
-#define SK6812_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
-#define SK6812_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
-#define SK6812_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
-#define SK6812_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
-#define SK6812_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
-#define SK6812_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_SK6812 SK6812_1H_CY, SK6812_1L_CY, SK6812_0H_CY, \
-	SK6812_0L_CY, SK6812_MS_REFRESH, dataPortId, dataPortBit, A, 0, RGBW, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class sk6812 : public avrBitbangLedStrip<FAB_TVAR_SK6812>
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::draw(
+		const fabSprite<bitsPerPixel> & sprite,
+		int16_t x,
+		int16_t y)
 {
-	public:
-	sk6812() : avrBitbangLedStrip<FAB_TVAR_SK6812>() {};
-	~sk6812() {};
-};
-#undef FAB_TVAR_SK6812
+	if (sprite.key > andMask) {
+		blit(x, y, sprite.width, sprite.height, sprite.bitmap());
+		return;
+	}
 
+	int16_t w = sprite.width;
+	int16_t h = sprite.height;
+	int16_t dx, dy;
+	if (!fabClip(width, height, x, y, w, h, dx, dy)) {
+		return;
+	}
+	const uint8_t * image = sprite.bitmap();
+	uint16_t to = (uint16_t) y * width + x;
+	uint16_t from = (uint16_t) dy * sprite.width + dx;
+	for (; h > 0; h--) {
+		fabCopyBitsKeyed<bitsPerPixel>(
+			&pixels[to / perByte], (to % perByte) * bitsPerPixel,
+			&image[from / perByte], (from % perByte) * bitsPerPixel,
+			(uint16_t) w * bitsPerPixel, sprite.key);
+		to += width;
+		from += sprite.width;
+	}
+}
 
+template <uint8_t width, uint8_t height, uint8_t bitsPerPixel, matrixLayout layout>
+template <class ledStrip>
+inline void
+fabMatrix<width, height, fabPacked<bitsPerPixel>, layout>::send(
+		ledStrip & strip,
+		const uint8_t * palette,
+		const uint8_t rotate) const
+{
+	if (layout == MATRIX_ROWS) {
+		strip.template sendPixels<bitsPerPixel>(numPixels, pixels, palette,
+			rotate);
+		return;
+	}
 
+	// Nested sends restore interrupts to the state saved here: off.
+	DISABLE_INTERRUPTS;
+	typename ledStrip::indexT first = 0;
+	for (uint8_t y = 0; y < height; y++) {
+		if (y & 1) {
+			strip.template sendPixelsStrided<bitsPerPixel>(width, pixels,
+				first + width - 1, -1, palette, rotate);
+		} else {
+			strip.template sendPixelsStrided<bitsPerPixel>(width, pixels,
+				first, 1, palette, rotate);
+		}
+		first += width;
+	}
+	RESTORE_INTERRUPTS;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-// SK6812B (4 color GRBW LEDs, faster PWM frequency, updated timings)
-/// @note I need to use microsleep to not round up sleep to 1msec.
+/// @brief Compositor layer streaming a sprite over a LED matrix of columns
+/// pixels per row, wired in MATRIX_ROWS layout, with its top left corner at
+/// (x, y), see sendComposited(). Transparent and outside pixels show the
+/// layers below, so sprites move over a background without a frame buffer.
+///
+/// The pixels are walked with counters and the bitmap decoded a byte at a
+/// time, so its cost does not depend on the sprite position. It grows with
+/// the color indexes per byte: at 16MHz, a ws2812b LED strip fits a sprite
+/// of any size over a fabFillLayer, and a 2 to 8-bit sprite over a
+/// fabPaletteLayer. 1-bit sprites over an image need an SPI LED strip.
+///
+/// Example:
+/// fabFillLayer sky = {{0, 0, 16, 0}};
+/// fabMatrixSpriteLayer<2> ship = {&invader, x, y, 16};
+/// strip.sendComposited(16 * 16, sky, ship);
 ////////////////////////////////////////////////////////////////////////////////
-#define SK6812B_1H_CY CYCLES(1210) // 500ns 1210ns-1510ns _----------__
-#define SK6812B_1L_CY CYCLES(200)  // 125ns  200ns-500ns  .    .    .
-#define SK6812B_0H_CY CYCLES(200)  // 125ns  200ns-500ns  _-----_______
-#define SK6812B_0L_CY CYCLES(1210) // 500ns 1210ns-1510ns .    .    .
-#define SK6812B_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
-#define SK6812B_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_SK6812B SK6812B_1H_CY, SK6812B_1L_CY, SK6812B_0H_CY, \
-	SK6812B_0L_CY, SK6812B_MS_REFRESH, dataPortId, dataPortBit, A, 0, GRBW, ONE_PORT_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit>
-class sk6812b : public avrBitbangLedStrip<FAB_TVAR_SK6812B>
-{
-	public:
-	sk6812b() : avrBitbangLedStrip<FAB_TVAR_SK6812B>() {};
-	~sk6812b() {};
-};
-#undef FAB_TVAR_SK6812B
+template <uint8_t bitsPerPixel>
+struct fabMatrixSpriteLayer {
+	static const uint8_t andMask = (1 << bitsPerPixel) - 1;
+	static const uint8_t perByte = 8 / bitsPerPixel;
+	// Estimate of the last visible pixel of a row, which skips the sprite
+	// pixels clipped out of the next row, with one constant shift per bit
+	// of the color index offset in a byte.
+	static const uint8_t cycles = 40 + 5 * ((bitsPerPixel < 8) +
+		(bitsPerPixel < 4) + (bitsPerPixel < 2));
+
+	const fabSprite<bitsPerPixel> * sprite;
+	int16_t x;
+	int16_t y;
+	uint8_t columns;
+	const uint8_t * bitmap; // Frame drawn, set by start()
+	const uint8_t * palette;
+	uint16_t key;
+	const uint8_t * next;   // Byte of the bitmap decoded after elem
+	uint8_t elem;           // Byte of the bitmap being decoded
+	uint8_t left;           // Color indexes left in elem
+	uint16_t skip;          // LED pixels left before a visible sprite pixel
+	uint8_t run;            // Visible sprite pixels left in the row
+	uint8_t rows;           // Rows of visible sprite pixels left
+	uint8_t visible;        // Visible sprite pixels per row
+	uint8_t gap;            // LED pixels between two rows of visible pixels
+	uint8_t clipped;        // Sprite pixels clipped out between two rows
+	const uint8_t * entry;  // Palette entry of the pixel, NULL if transparent
+
+	/// @brief Computes the visible part of the sprite, clipped to the LED
+	/// matrix, and the steps walking it. Called by sendComposited() before
+	/// the send, so the multiplies and divides stay out of its timing.
+	inline void start() {
+		bitmap = sprite->bitmap();
+		palette = sprite->palette;
+		key = sprite->key;
+		rows = 0;
+		const int16_t first = (x < 0) ? -x : 0;
+		const int16_t top = (y < 0) ? -y : 0;
+		int16_t end = (int16_t) columns - x;
+		if (end > sprite->width) {
+			end = sprite->width;
+		}
+		if (first >= end || top >= sprite->height) {
+			return;
+		}
+		visible = end - first;
+		rows = sprite->height - top;
+		gap = columns - visible;
+		clipped = sprite->width - visible;
+		run = visible;
+		skip = (uint16_t) (y + top) * columns + x + first;
+		const uint16_t index = (uint16_t) top * sprite->width + first;
+		next = &bitmap[index / perByte];
+		left = 0;
+		skipPixels(index % perByte);
+	}
 
+	/// @brief Skips count color indexes of the bitmap.
+	inline void skipPixels(uint8_t count) {
+		if (count >= left) {
+			count -= left;
+			next += count / perByte;
+			count %= perByte;
+			elem = *next++;
+			left = perByte;
+		}
+		left -= count;
+		// Shift by count color indexes, less than 8 bits
+		const uint8_t bits = count * bitsPerPixel;
+		if (bitsPerPixel < 8 && (bits & 4)) elem >>= 4;
+		if (bitsPerPixel < 4 && (bits & 2)) elem >>= 2;
+		if (bitsPerPixel < 2 && (bits & 1)) elem >>= 1;
+	}
 
-////////////////////////////////////////////////////////////////////////////////
-// APA-102 (3 color RGB LEDs, SPI protocol)
-////////////////////////////////////////////////////////////////////////////////
-#define APA102_1H_CY CYCLES(0) // Unused
-#define APA102_1L_CY CYCLES(0)  // Unused
-#define APA102_0H_CY CYCLES(0)  // Unused
-#define APA102_0L_CY CYCLES(0) // Unused
-#define APA102_MS_REFRESH 84      //  84,000ns Minimum wait time to reset LED strip
-#define APA102_NS_RF  833333      // Max refresh rate for all pixels to light up 2msec (LED PWM is 500Hz)
-#define FAB_TVAR_APA102 APA102_1H_CY, APA102_1L_CY, APA102_0H_CY, \
-	APA102_0L_CY, APA102_MS_REFRESH, dataPortId, dataPortBit, clockPortId, clockPortBit, HBGR, SPI_BITBANG
-template<avrLedStripPort dataPortId, uint8_t dataPortBit, avrLedStripPort clockPortId, uint8_t clockPortBit>
-class apa102 : public avrBitbangLedStrip<FAB_TVAR_APA102>
-{
-	public:
-	apa102() : avrBitbangLedStrip<FAB_TVAR_APA102>() {};
-	~apa102() {};
+	template <uint8_t bytesPerPixel, class indexType>
+	inline void pixel(const indexType) {
+		entry = NULL;
+		if (skip > 0) {
+			skip--;
+			return;
+		}
+		if (rows == 0) {
+			return;
+		}
+		if (left == 0) {
+			elem = *next++;
+			left = perByte;
+		}
+		const uint8_t colorIndex = elem & andMask;
+		elem >>= bitsPerPixel;
+		left--;
+		if (colorIndex != key) {
+			entry = &palette[bytesPerPixel * colorIndex];
+		}
+		if (--run == 0) {
+			run = visible;
+			skip = gap;
+			if (--rows > 0 && clipped > 0) {
+				skipPixels(clipped);
+			}
+		}
+	}
+
+	inline void blend(const uint8_t byte, uint8_t & value) {
+		if (entry) {
+			value = entry[byte];
+		}
+	}
 };
-#undef FAB_TVAR_APA102
 
 #endif // FAB_LED_H
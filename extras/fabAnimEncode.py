@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+################################################################################
+# Fast Adressable Bitbang LED Library
+#
+# Host encoder for the fabAnimation compressed palette animation format.
+#
+# Converts raw RGB frame dumps (3 bytes per pixel, frames concatenated, for
+# example from "ffmpeg -i movie.mp4 -s 8x8 -f rawvideo -pix_fmt rgb24 out.raw")
+# to a stream of keyframes, delta frames and palette changes that the
+# fabAnimation class of FAB_LED.h decodes on the micro-controller.
+#
+# Example:
+#   fabAnimEncode.py out.raw --pixels 64 --bits 4 --ms 40 --header movie.h
+#
+# The --verify option decodes the result with a copy of the fabAnimation
+# decoder and checks every frame against the palette-reduced input.
+################################################################################
+
+import argparse
+import sys
+
+MAGIC = b'FA'
+
+
+def array_size(num_pixels, bits):
+	"""Size of a packed pixel array, same as the ARRAY_SIZE() macro."""
+	return (num_pixels + 7) // 8 * bits
+
+
+def pack(indexes, bits):
+	"""Packs color indexes like SET_PIXEL(): lowest bits first in each byte."""
+	packed = bytearray(array_size(len(indexes), bits))
+	per_byte = 8 // bits
+	for i, index in enumerate(indexes):
+		packed[i // per_byte] |= index << ((i % per_byte) * bits)
+	return packed
+
+
+def unpack(packed, num_pixels, bits):
+	per_byte = 8 // bits
+	mask = (1 << bits) - 1
+	return [(packed[i // per_byte] >> ((i % per_byte) * bits)) & mask
+		for i in range(num_pixels)]
+
+
+def nearest(color, colors):
+	return min(colors, key=lambda c: sum((a - b) ** 2 for a, b in zip(c, color)))
+
+
+def update_palette(palette, frame):
+	"""Returns the palette for a frame, keeping the slots of colors already
+	in the previous palette so that unchanged pixels keep their index, and the
+	frame with colors reduced to the palette."""
+	counts = {}
+	for color in frame:
+		counts[color] = counts.get(color, 0) + 1
+	chosen = sorted(counts, key=lambda c: -counts[c])[:len(palette)]
+
+	# Most used colors, in their previous slots, then in free slots
+	result = [c if c in chosen else None for c in palette]
+	free = [i for i, c in enumerate(result) if c is None]
+	free.sort(key=lambda i: palette[i] is not None)
+	for color in chosen:
+		if color not in result:
+			result[free.pop(0)] = color
+	for i, color in enumerate(result):
+		if color is None:
+			result[i] = palette[i] if palette[i] is not None else (0, 0, 0)
+
+	if len(counts) > len(chosen):
+		remap = dict((c, c if c in chosen else nearest(c, chosen)) for c in counts)
+		frame = [remap[c] for c in frame]
+	return result, frame
+
+
+def palette_records(old, new):
+	"""'P' records for the runs of palette entries that changed."""
+	out = bytearray()
+	i = 0
+	while i < len(new):
+		if old[i] == new[i]:
+			i += 1
+			continue
+		first = i
+		while i < len(new) and old[i] != new[i]:
+			i += 1
+		out += b'P' + bytes([first, (i - first) & 0xFF])
+		for color in new[first:i]:
+			out += bytes(color)
+	return out
+
+
+def delta_record(old, new):
+	"""'D' record with runs of changed bytes, merging runs split by 1 or 2
+	unchanged bytes, which cost less than a new run header."""
+	runs = []
+	i = 0
+	while i < len(new):
+		if old[i] == new[i]:
+			i += 1
+			continue
+		start = i
+		end = i + 1
+		while end < len(new):
+			if old[end] != new[end]:
+				end += 1
+			elif any(old[j] != new[j] for j in range(end + 1, min(end + 3, len(new)))):
+				end += 1
+			else:
+				break
+		runs.append((start, end))
+		i = end
+
+	out = bytearray(b'D')
+	pos = 0
+	for start, end in runs:
+		skip = start - pos
+		while skip > 255:
+			out += bytes([255, 0])
+			skip -= 255
+		while end - start > 0:
+			length = min(end - start, 255)
+			out += bytes([skip, length]) + new[start:start + length]
+			start += length
+			skip = 0
+		pos = end
+	out += bytes([0, 0])
+	return out
+
+
+def encode(frames, num_pixels, bits, ms, keyframe_interval):
+	"""Returns the encoded stream and the palette-reduced frames."""
+	out = bytearray(MAGIC + bytes([bits, num_pixels & 0xFF, num_pixels >> 8,
+		ms & 0xFF, ms >> 8]))
+	palette = [None] * (1 << bits)
+	previous = None
+	reduced = []
+	for n, frame in enumerate(frames):
+		new_palette, frame = update_palette(palette, frame)
+		reduced.append(frame)
+		out += palette_records([c if c is not None else (0, 0, 0)
+			for c in palette], new_palette)
+		palette = new_palette
+
+		slots = dict((c, i) for i, c in reversed(list(enumerate(palette))))
+		packed = pack([slots[c] for c in frame], bits)
+		key = b'K' + packed
+		if previous is None or (keyframe_interval and n % keyframe_interval == 0):
+			out += key
+		else:
+			delta = delta_record(previous, packed)
+			out += delta if len(delta) < len(key) else key
+		previous = packed
+	out += b'E'
+	return out, reduced
+
+
+def decode(stream, num_pixels, bits):
+	"""Reference decoder, same as fabAnimation::nextFrame()."""
+	size = array_size(num_pixels, bits)
+	if stream[0:2] != MAGIC or stream[2] != bits or \
+			stream[3] | stream[4] << 8 != num_pixels:
+		raise ValueError('header does not match')
+	pos = 7
+	pixels = bytearray(size)
+	palette = [(0, 0, 0)] * (1 << bits)
+	while True:
+		record = stream[pos:pos + 1]
+		pos += 1
+		if record == b'P':
+			first, count = stream[pos], stream[pos + 1] or 256
+			pos += 2
+			for i in range(first, first + count):
+				palette[i] = tuple(stream[pos:pos + 3])
+				pos += 3
+		elif record == b'K':
+			pixels[:] = stream[pos:pos + size]
+			pos += size
+			yield [palette[i] for i in unpack(pixels, num_pixels, bits)]
+		elif record == b'D':
+			offset = 0
+			while True:
+				skip, length = stream[pos], stream[pos + 1]
+				pos += 2
+				if skip == 0 and length == 0:
+					break
+				offset += skip
+				pixels[offset:offset + length] = stream[pos:pos + length]
+				offset += length
+				pos += length
+			yield [palette[i] for i in unpack(pixels, num_pixels, bits)]
+		elif record == b'E':
+			return
+		else:
+			raise ValueError('bad record %r at %d' % (record, pos - 1))
+
+
+def write_header(f, name, stream):
+	f.write('// Generated by fabAnimEncode.py, %d bytes\n' % len(stream))
+	f.write('const uint8_t %s[] PROGMEM = {\n' % name)
+	for i in range(0, len(stream), 16):
+		f.write('\t' + ', '.join('0x%02x' % b for b in stream[i:i + 16]) + ',\n')
+	f.write('};\n')
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		description='Encodes raw RGB frames for the FAB_LED fabAnimation decoder.')
+	parser.add_argument('input', nargs='+', help='raw RGB frame dump files')
+	parser.add_argument('--pixels', type=int, required=True,
+		help='number of pixels per frame')
+	parser.add_argument('--bits', type=int, default=4, choices=(1, 2, 4, 8),
+		help='bits per pixel of the palette, default 4 (16 colors)')
+	parser.add_argument('--ms', type=int, default=40,
+		help='frame duration in milliseconds, default 40')
+	parser.add_argument('--keyframe', type=int, default=0,
+		help='keyframe interval in frames, default 0 (first frame only)')
+	parser.add_argument('--output', '-o', help='binary output file')
+	parser.add_argument('--header', help='C header output file, for PROGMEM')
+	parser.add_argument('--name', default='animation',
+		help='array name in the C header')
+	parser.add_argument('--verify', action='store_true',
+		help='decode the result and compare it to the input frames')
+	args = parser.parse_args()
+
+	raw = b''.join(open(name, 'rb').read() for name in args.input)
+	frame_size = 3 * args.pixels
+	if not raw or len(raw) % frame_size:
+		sys.exit('input is not a whole number of %d-byte frames' % frame_size)
+	frames = [[tuple(raw[i + j:i + j + 3]) for j in range(0, frame_size, 3)]
+		for i in range(0, len(raw), frame_size)]
+
+	stream, reduced = encode(frames, args.pixels, args.bits, args.ms,
+		args.keyframe)
+
+	if args.verify:
+		decoded = list(decode(stream, args.pixels, args.bits))
+		if decoded != reduced:
+			sys.exit('verify failed')
+
+	if args.output:
+		open(args.output, 'wb').write(stream)
+	if args.header:
+		with open(args.header, 'w') as f:
+			write_header(f, args.name, stream)
+	print('%d frames, %d bytes raw, %d bytes encoded' %
+		(len(frames), len(raw), len(stream)))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Minimal Arduino.h for the host tests: just enough for FAB_LED.h to compile
+// on a computer, to validate its plain C routines. Nothing here drives LEDs,
+// the LED strip templates are only instantiated by the compile check of the
+// examples, which never runs them.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FAB_HOST_ARDUINO_H
+#define FAB_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define F_CPU 16000000UL
+#define ARDUINO_ARCH_AVR
+
+// Flash memory is plain memory on the host
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+// AVR registers and built-ins, declared for the LED strip templates only
+extern uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF;
+extern uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+extern uint8_t SREG;
+extern uint8_t TCCR1A, TCCR1B;
+extern uint16_t TCNT1;
+#define CS10 0
+#define _BV(bit) (1 << (bit))
+#define __builtin_avr_delay_cycles(n)
+#define __builtin_avr_cli()
+#define cli()
+#define sei()
+
+#define LOW    0
+#define HIGH   1
+#define OUTPUT 1
+
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned int) {}
+inline unsigned long micros() { return 0; }
+inline unsigned long millis() { return 0; }
+inline long random(long max) { return max - 1; }
+inline long random(long min, long max) { return min < max ? min : max; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+// Serial console of the examples, prints nothing
+struct HardwareSerial {
+	void begin(unsigned long) {}
+	template <class T> size_t print(T) { return 0; }
+	template <class T> size_t print(T, int) { return 0; }
+	template <class T> size_t println(T) { return 0; }
+	template <class T> size_t println(T, int) { return 0; }
+	size_t println() { return 0; }
+};
+extern HardwareSerial Serial;
+#define HEX 16
+#define DEC 10
+
+#endif // FAB_HOST_ARDUINO_H
@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+################################################################################
+# Fast Adressable Bitbang LED Library
+#
+# Writes the C header of animationTest.cpp to stdout: a test animation
+# encoded by fabAnimEncode.py with 1, 2, 4 and 8-bit palettes, and for each
+# the palette-reduced RGB frames the decoder must reproduce.
+################################################################################
+
+import os
+import sys
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import fabAnimEncode
+
+PIXELS = 20
+FRAMES = 30
+MS = 40
+
+
+def frames():
+	"""A bar of 5 pixels moving over a slowly changing background, with 24
+	colors overall: palettes change, and most frames are deltas."""
+	colors = [((i * 37) & 0xFF, (i * 91) & 0xFF, (i * 53) & 0xFF) for i in range(24)]
+	result = []
+	for f in range(FRAMES):
+		frame = [colors[(i // 4 + f // 6) % 12] for i in range(PIXELS)]
+		for i in range(5):
+			frame[(f + i) % PIXELS] = colors[12 + (f // 3 + i) % 12]
+		result.append(frame)
+	return result
+
+
+def array(name, values):
+	out = 'const uint8_t %s[] PROGMEM = {\n' % name
+	for i in range(0, len(values), 16):
+		out += '\t' + ', '.join('0x%02x' % v for v in values[i:i + 16]) + ',\n'
+	return out + '};\n'
+
+
+def main():
+	print('// Generated by animTestData.py')
+	print('const uint16_t animPixels = %d;' % PIXELS)
+	print('const uint16_t animFrames = %d;' % FRAMES)
+	print('const uint16_t animMs = %d;' % MS)
+	for bits in (1, 2, 4, 8):
+		stream, reduced = fabAnimEncode.encode(frames(), PIXELS, bits, MS, 0)
+		rgb = [c for frame in reduced for pixel in frame for c in pixel]
+		print(array('anim%d' % bits, stream))
+		print(array('anim%dFrames' % bits, rgb))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Host test of the fabAnimation decoder against streams encoded by
+// extras/fabAnimEncode.py with 1, 2, 4 and 8-bit palettes: every frame must
+// match the palette-reduced frames of the encoder, see animTestData.py.
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include "FAB_LED.h"
+#include "animTestData.h"
+
+static int failures = 0;
+
+static void check(const bool ok, const char * what)
+{
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+// Compares the current frame of an animation to an RGB frame of the encoder
+template <uint8_t bitsPerPixel>
+static bool sameFrame(
+		const fabAnimation<bitsPerPixel, animPixels, fabFlashSource> & anim,
+		const uint8_t * expected)
+{
+	for (uint16_t i = 0; i < animPixels; i++) {
+		const uint8_t color = GET_PIXEL(anim.pixels, i, bitsPerPixel);
+		const rgb & pixel = anim.palette[color];
+		if (pixel.r != expected[3 * i] || pixel.g != expected[3 * i + 1] ||
+				pixel.b != expected[3 * i + 2]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <uint8_t bitsPerPixel>
+static void testStream(const uint8_t * stream, const uint8_t * frames)
+{
+	typedef fabAnimation<bitsPerPixel, animPixels, fabFlashSource> animation;
+	const fabFlashSource source = {stream};
+	animation anim(source);
+	char what[80];
+
+	snprintf(what, sizeof(what), "%u-bit header", bitsPerPixel);
+	check(anim.valid && anim.frameMs == animMs, what);
+
+	// Twice, to check rewind() restarts from a clean state
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		uint16_t frame = 0;
+		bool same = true;
+		while (anim.nextFrame()) {
+			if (frame < animFrames) {
+				same = same && sameFrame(anim, &frames[3 * animPixels * frame]);
+			}
+			frame++;
+		}
+		snprintf(what, sizeof(what), "%u-bit pass %u: %u frames decoded",
+			bitsPerPixel, pass, frame);
+		check(frame == animFrames, what);
+		snprintf(what, sizeof(what), "%u-bit pass %u frames", bitsPerPixel, pass);
+		check(same, what);
+
+		// The end of the animation keeps the last frame
+		snprintf(what, sizeof(what), "%u-bit last frame kept", bitsPerPixel);
+		check(!anim.nextFrame() &&
+			sameFrame(anim, &frames[3 * animPixels * (animFrames - 1)]), what);
+		anim.rewind();
+	}
+}
+
+int main()
+{
+	testStream<1>(anim1, anim1Frames);
+	testStream<2>(anim2, anim2Frames);
+	testStream<4>(anim4, anim4Frames);
+	testStream<8>(anim8, anim8Frames);
+
+	// A header that does not match the template parameters is rejected
+	const fabFlashSource source = {anim4};
+	fabAnimation<2, animPixels, fabFlashSource> wrongBits(source);
+	check(!wrongBits.valid && !wrongBits.nextFrame(), "wrong bits rejected");
+	fabAnimation<4, animPixels + 1, fabFlashSource> wrongPixels(source);
+	check(!wrongPixels.valid && !wrongPixels.nextFrame(), "wrong pixels rejected");
+
+	// A corrupt record stops the animation
+	uint8_t corrupt[sizeof(anim4)];
+	memcpy(corrupt, anim4, sizeof(anim4));
+	corrupt[7] = 'X';
+	const fabArraySource corruptSource = {corrupt};
+	fabAnimation<4, animPixels, fabArraySource> bad(corruptSource);
+	check(bad.valid && !bad.nextFrame(), "corrupt record rejected");
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("animationTest passed\n");
+	return 0;
+}
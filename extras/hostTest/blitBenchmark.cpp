@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Host benchmark of the packed sprite blits of fabMatrix, built on the plain
+// C fabCopyBits() and fabCopyBitsKeyed(): checks them against a pixel by
+// pixel reference, then prints blits per second of both, like the
+// benchSprites() part of the H_benchmark example on a micro-controller.
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <chrono>
+#include "FAB_LED.h"
+
+typedef std::chrono::steady_clock benchClock;
+
+static int failures = 0;
+
+// Pixel by pixel sprite drawing, clipped by set()
+template <class matrix, uint8_t bitsPerPixel>
+static void referenceDraw(matrix & m, const fabSprite<bitsPerPixel> & sprite,
+		const int16_t x, const int16_t y)
+{
+	const uint8_t * image = sprite.bitmap();
+	for (uint8_t j = 0; j < sprite.height; j++) {
+		for (uint8_t i = 0; i < sprite.width; i++) {
+			const uint8_t color = GET_PIXEL(image,
+				(uint16_t) j * sprite.width + i, bitsPerPixel);
+			if (color != sprite.key) {
+				m.set(x + i, y + j, color);
+			}
+		}
+	}
+}
+
+// Sprite positions, mostly not aligned on bytes, some clipped
+static inline int16_t posX(const uint16_t i, const uint8_t size)
+{
+	return (i % 37) - size / 2;
+}
+
+static inline int16_t posY(const uint16_t i, const uint8_t size)
+{
+	return (i % 29) - size / 2;
+}
+
+template <uint8_t bitsPerPixel, uint8_t size>
+static void bench(const uint16_t key)
+{
+	typedef fabMatrix<32, 32, fabPacked<bitsPerPixel> > matrix;
+	static matrix fast, slow;
+	static uint8_t bitmap[ARRAY_SIZE(size * size, bitsPerPixel)];
+	for (uint16_t i = 0; i < sizeof(bitmap); i++) {
+		bitmap[i] = 0x1B * i + 0xE4;
+	}
+	const fabSprite<bitsPerPixel> sprite = {size, size, bitmap, NULL, key, 0};
+
+	// Same pixels as the reference, over a background
+	const uint16_t checks = 2000;
+	for (uint16_t i = 0; i < checks; i++) {
+		for (uint16_t b = 0; b < sizeof(fast.pixels); b++) {
+			fast.pixels[b] = slow.pixels[b] = 0x5A + b * i;
+		}
+		fast.draw(sprite, posX(i, size), posY(i, size));
+		referenceDraw(slow, sprite, posX(i, size), posY(i, size));
+		if (memcmp(fast.pixels, slow.pixels, sizeof(fast.pixels))) {
+			printf("FAIL: %u-bit %ux%u key %u differs at (%d, %d)\n",
+				bitsPerPixel, size, size, key,
+				posX(i, size), posY(i, size));
+			failures++;
+			return;
+		}
+	}
+
+	// Blits per second
+	const uint32_t blits = 200000;
+	benchClock::time_point start = benchClock::now();
+	for (uint32_t i = 0; i < blits; i++) {
+		fast.draw(sprite, posX(i, size), posY(i, size));
+	}
+	const double fastSeconds =
+		std::chrono::duration<double>(benchClock::now() - start).count();
+
+	start = benchClock::now();
+	for (uint32_t i = 0; i < blits; i++) {
+		referenceDraw(slow, sprite, posX(i, size), posY(i, size));
+	}
+	const double slowSeconds =
+		std::chrono::duration<double>(benchClock::now() - start).count();
+
+	// Keep the results alive
+	volatile uint8_t sink = fast.pixels[0] ^ slow.pixels[0];
+	(void) sink;
+
+	printf("%u-bit %2ux%-2u %s: %10.0f blits/s, pixel by pixel %10.0f, x%.1f\n",
+		bitsPerPixel, size, size, (key > 0xFF) ? "opaque" : "keyed ",
+		blits / fastSeconds, blits / slowSeconds, slowSeconds / fastSeconds);
+}
+
+int main()
+{
+	bench<1, 8>(0);
+	bench<1, 16>(0);
+	bench<2, 8>(0);
+	bench<2, 16>(0);
+	bench<2, 8>(0x100);
+	bench<2, 16>(0x100);
+	bench<4, 8>(0);
+	bench<4, 16>(0);
+	bench<8, 8>(0);
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Host test of the temporal dithering of 16-bit colors, fabDither(),
+// fabDitherThreshold() and fabDitherSource: over 256 frames, or over 256
+// pixels of a frame, a 8.8 fixed point color averages to exactly value/256.
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include "FAB_LED.h"
+
+static int failures = 0;
+
+static void check(const bool ok, const char * what)
+{
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+// Sum of 256 dithered outputs of a color: value, or 255*256 once clipped
+static uint32_t expectedSum(const uint16_t value)
+{
+	return (value >= 0xFF00) ? 0xFF00 : value;
+}
+
+int main()
+{
+	// The thresholds of 256 frames are a permutation of 0..255, and every
+	// aligned run of 2^n frames spreads evenly, 256/2^n apart.
+	bool seen[256] = {false};
+	bool permutation = true;
+	for (uint16_t frame = 0; frame < 256; frame++) {
+		const uint8_t t = fabDitherThreshold(frame);
+		permutation = permutation && !seen[t];
+		seen[t] = true;
+	}
+	check(permutation, "frame thresholds take every value once");
+	check(fabDitherThreshold(0) == 0 && fabDitherThreshold(1) == 128 &&
+		fabDitherThreshold(2) == 64 && fabDitherThreshold(3) == 192,
+		"frame thresholds are the bit-reversed frame counter");
+	bool even = true;
+	for (uint16_t run = 2; run <= 256; run *= 2) {
+		for (uint16_t first = 0; first < 256; first += run) {
+			bool hit[256] = {false};
+			for (uint16_t f = first; f < first + run; f++) {
+				hit[fabDitherThreshold(f) & ~(256 / run - 1)] = true;
+			}
+			for (uint16_t t = 0; t < 256; t += 256 / run) {
+				even = even && hit[t];
+			}
+		}
+	}
+	check(even, "aligned runs of frames spread their thresholds evenly");
+
+	// The average over 256 frames is exact for every color
+	bool exactFrames = true;
+	for (uint32_t value = 0; value < 65536; value++) {
+		uint32_t sum = 0;
+		for (uint16_t frame = 0; frame < 256; frame++) {
+			sum += fabDither(value, fabDitherThreshold(frame));
+		}
+		if (sum != expectedSum(value)) {
+			printf("color 0x%04x: 256-frame sum %u, expected %u\n",
+				(unsigned) value, (unsigned) sum, (unsigned) expectedSum(value));
+			exactFrames = false;
+			break;
+		}
+	}
+	check(exactFrames, "256-frame average is value/256");
+
+	// Within a frame, fabDitherSource moves the threshold on every pixel:
+	// 256 pixels of one color take every threshold once, whatever the frame
+	// threshold, so the average of a frame is exact too.
+	static rgb48 pixels[256];
+	bool stepped = true;
+	bool exactPixels = true;
+	for (uint32_t value = 0; value < 65536; value += 0x35) {
+		for (uint16_t i = 0; i < 256; i++) {
+			pixels[i].r = value;
+			pixels[i].g = 0xFFFF - value;
+			pixels[i].b = value;
+		}
+		const uint8_t frameThreshold = fabDitherThreshold(value);
+		fabDitherSource<3> source = {(const uint16_t *) pixels,
+			{1, 0, 2, 0xFF}, 0x00, 3, frameThreshold, 0};
+		uint32_t sum[3] = {0, 0, 0};
+		for (uint16_t i = 0; i < 256; i++) {
+			const uint8_t t = frameThreshold + i * FAB_DITHER_PIXEL_STEP;
+			const uint8_t g = source.next();
+			const uint8_t r = source.next();
+			const uint8_t b = source.next();
+			stepped = stepped && g == fabDither(pixels[i].g, t) &&
+				r == fabDither(pixels[i].r, t) && b == fabDither(pixels[i].b, t);
+			sum[0] += r;
+			sum[1] += g;
+			sum[2] += b;
+		}
+		exactPixels = exactPixels && sum[0] == expectedSum(value) &&
+			sum[1] == expectedSum(0xFFFF - value) && sum[2] == expectedSum(value);
+	}
+	check(stepped, "pixel thresholds step by FAB_DITHER_PIXEL_STEP");
+	check(exactPixels, "256-pixel average is value/256");
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("ditherTest passed\n");
+	return 0;
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Host test of the APA102 high dynamic range routines, fabHdrLevel() and
+// fabHdrColor(): a 16-bit color c is displayed as level/31 * pwm/255, which
+// must be within 0.6 PWM step of c/65535, see sendPixelsHDR().
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <math.h>
+#include "FAB_LED.h"
+
+static int failures = 0;
+
+static void check(const bool ok, const char * what)
+{
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+int main()
+{
+	// Every color at every level able to display it
+	double maxError = 0;
+	uint16_t worstColor = 0;
+	uint8_t worstLevel = 0;
+	bool minimal = true;
+	for (uint32_t c = 0; c < 65536; c++) {
+		const uint8_t lowest = fabHdrLevel(c);
+		// The level below the one picked would clip the color
+		if (lowest > 1 && c <= (lowest - 1) * 65535.0 / 31) {
+			minimal = false;
+		}
+		for (uint8_t level = lowest; level <= 31; level++) {
+			const double step = level / 31.0 / 255.0 * 65535.0;
+			const double out = fabHdrColor(c, level) * step;
+			const double error = fabs(out - c) / step;
+			if (error > maxError) {
+				maxError = error;
+				worstColor = c;
+				worstLevel = level;
+			}
+		}
+	}
+	printf("max quantization error %.3f PWM step (color %u, level %u)\n",
+		maxError, worstColor, worstLevel);
+	check(maxError < 0.6, "quantization error below 0.6 PWM step");
+	check(minimal, "lowest level that fits the color");
+
+	// Limits of the current levels
+	check(fabHdrLevel(0) == 1, "black uses level 1");
+	check(fabHdrLevel(0xFFFF) == 31, "full color uses level 31");
+	check(fabHdrColor(0xFFFF, 31) == 255, "full color is PWM 255");
+	check(fabHdrColor(0, 31) == 0, "black is PWM 0");
+
+	// Half green next to full red stays linear: gamma does not apply
+	check(fabHdrColor(0x8000, 31) == 0x80, "half color is PWM 0x80");
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("hdrTest passed\n");
+	return 0;
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+// Fast Adressable Bitbang LED Library
+//
+// Host test of fabMatrixSpriteLayer: the palette entry of each LED matrix
+// pixel must be the sprite pixel over it, clipped and keyed, for random
+// sprite sizes, positions and matrix widths. Also checks that the composites
+// documented as fitting a 16MHz ws2812b LED strip pass its budget.
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include "FAB_LED.h"
+
+static int failures = 0;
+
+// 2 frames of the largest sprite, 20x20 8-bit pixels
+static uint8_t frames[2 * 20 * 20];
+static uint8_t palette[3 * 256];
+
+// Composites documented as fitting a 16MHz ws2812b LED strip
+template <class layer0, class layer1>
+static bool fits(void)
+{
+	return fabCompositor<3, layer0, layer1>::cycles <=
+		ws2812b<D,6>::sourceCycles;
+}
+
+template <uint8_t bitsPerPixel>
+static void check(const uint8_t width, const uint8_t height,
+		const int16_t x, const int16_t y,
+		const uint8_t columns, const uint8_t rows)
+{
+	const fabSprite<bitsPerPixel> sprite = {width, height, frames, palette,
+		(uint16_t) (rand() % (1 << bitsPerPixel)), (uint8_t) (rand() % 2)};
+	fabMatrixSpriteLayer<bitsPerPixel> layer = {&sprite, x, y, columns};
+	layer.start();
+	const uint8_t * image = sprite.bitmap();
+
+	for (int16_t j = 0; j < rows; j++) {
+		for (int16_t i = 0; i < columns; i++) {
+			layer.template pixel<3>((uint16_t) 0);
+
+			const uint8_t * entry = NULL;
+			const int16_t sx = i - x;
+			const int16_t sy = j - y;
+			if (sx >= 0 && sx < width && sy >= 0 && sy < height) {
+				const uint8_t color = GET_PIXEL(image,
+					(uint16_t) sy * width + sx, bitsPerPixel);
+				if (color != sprite.key) {
+					entry = &palette[3 * color];
+				}
+			}
+			if (layer.entry != entry) {
+				printf("FAIL: %u-bit %ux%u at (%d, %d) on %u columns, "
+					"pixel (%d, %d)\n", bitsPerPixel, width, height,
+					x, y, columns, i, j);
+				failures++;
+				return;
+			}
+		}
+	}
+}
+
+int main()
+{
+	for (uint16_t i = 0; i < sizeof(frames); i++) {
+		frames[i] = rand();
+	}
+
+	// Sprites inside, clipped on any side, or wider than the matrix
+	for (uint16_t t = 0; t < 5000; t++) {
+		const uint8_t width = 1 + rand() % 20;
+		const uint8_t height = 1 + rand() % 20;
+		const int16_t x = rand() % 50 - 25;
+		const int16_t y = rand() % 50 - 25;
+		const uint8_t columns = 1 + rand() % 24;
+		const uint8_t rows = 1 + rand() % 24;
+		check<1>(width, height, x, y, columns, rows);
+		check<2>(width, height, x, y, columns, rows);
+		check<4>(width, height, x, y, columns, rows);
+		check<8>(width, height, x, y, columns, rows);
+	}
+
+	if (!fits<fabFillLayer, fabMatrixSpriteLayer<1> >() ||
+			!fits<fabPaletteLayer<4>, fabMatrixSpriteLayer<2> >() ||
+			!fits<fabPaletteLayer<1>, fabMatrixSpriteLayer<8> >()) {
+		printf("FAIL: documented composites exceed the ws2812b budget\n");
+		failures++;
+	}
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("spriteLayerTest passed\n");
+	return 0;
+}